@@ -8,13 +8,18 @@
 
 #include "line.h"
 #include "parse.h"
+#include "program.h"
 #include "read.h"
 #include "stack.h"
 #include "vector.h"
+#include "write.h"
 
+#include <ctype.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 /**
  * Sprawdza, czy udało się zaalokować pamięć. Jeśli nie, kończy działanie
@@ -28,16 +33,40 @@
         }                   \
     } while (0)
 
+/// zmienna środowiskowa z liczbą wątków, na których liczone są wielomiany
+#define THREADS_ENV "POLY_THREADS"
+
+/// opcja, z którą kalkulator kompiluje wejście do programu
+#define COMPILE_OPTION "--compile"
+
+/// opcja, z którą kalkulator wykonuje skompilowany program
+#define RUN_OPTION "--run"
+
+/// błąd oznaczający niepoprawny plik ze skompilowanym programem
+#define WRONG_PROGRAM "WRONG PROGRAM"
+
 /// błąd oznaczający zbyt mało argumentów na stosie
 #define STACK_UNDERFLOW "STACK UNDERFLOW"
 
+/**
+ * Wypisuje odpowiedź na polecenie w osobnym wierszu.
+ * @param[in,out] writer : pisarz standardowego wyjścia
+ * @param[in] answer : odpowiedź
+ */
+static inline void WriteAnswer(Writer *writer, long answer) {
+    WriteLong(writer, answer);
+    WriteChar(writer, '\n');
+}
+
 /**
  * Wykonuje polecenie lub wstawia wielomian na stos.
  * @param[in] line : wiersz z poleceniem lub wielomianem
  * @param[in,out] stack : stos
+ * @param[in,out] writer : pisarz standardowego wyjścia
  * @param[in] lineNr : numer wiersza
  */
-static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
+static inline void Calc(const Line *line, Stack *stack, Writer *writer,
+                        size_t lineNr) {
     if (line->status == POLY) {
         StackPush(stack, line->p);
     }
@@ -49,7 +78,7 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
             case IS_COEFF:
                 if (!StackEmpty(stack)) {
                     Poly p = StackTop(stack);
-                    printf("%d\n", PolyIsCoeff(&p));
+                    WriteAnswer(writer, PolyIsCoeff(&p));
                 }
                 else {
                     PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -59,7 +88,7 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
             case IS_ZERO:
                 if (!StackEmpty(stack)) {
                     Poly p = StackTop(stack);
-                    printf("%d\n", PolyIsZero(&p));
+                    WriteAnswer(writer, PolyIsZero(&p));
                 }
                 else {
                     PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -82,8 +111,8 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
                         Poly q = StackTop(stack);
                         StackPop(stack);
                         StackPush(stack, PolyAdd(&p, &q));
-                        PolyDestroy(&p);
-                        PolyDestroy(&q);
+                        PolyDestroyDeferred(&p);
+                        PolyDestroyDeferred(&q);
                     }
                     else {
                         StackPush(stack, p);
@@ -102,8 +131,8 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
                         Poly q = StackTop(stack);
                         StackPop(stack);
                         StackPush(stack, PolyMul(&p, &q));
-                        PolyDestroy(&p);
-                        PolyDestroy(&q);
+                        PolyDestroyDeferred(&p);
+                        PolyDestroyDeferred(&q);
                     }
                     else {
                         StackPush(stack, p);
@@ -119,7 +148,7 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
                     Poly p = StackTop(stack);
                     StackPop(stack);
                     StackPush(stack, PolyNeg(&p));
-                    PolyDestroy(&p);
+                    PolyDestroyDeferred(&p);
                 }
                 else {
                     PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -133,8 +162,8 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
                         Poly q = StackTop(stack);
                         StackPop(stack);
                         StackPush(stack, PolySub(&p, &q));
-                        PolyDestroy(&p);
-                        PolyDestroy(&q);
+                        PolyDestroyDeferred(&p);
+                        PolyDestroyDeferred(&q);
                     }
                     else {
                         StackPush(stack, p);
@@ -151,7 +180,7 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
                     StackPop(stack);
                     if (!StackEmpty(stack)) {
                         Poly q = StackTop(stack);
-                        printf("%d\n", PolyIsEq(&p, &q));
+                        WriteAnswer(writer, PolyIsEq(&p, &q));
                     }
                     else {
                         PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -165,7 +194,7 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
             case DEG:
                 if (!StackEmpty(stack)) {
                     Poly p = StackTop(stack);
-                    printf("%d\n", PolyDeg(&p));
+                    WriteAnswer(writer, PolyDeg(&p));
                 }
                 else {
                     PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -174,7 +203,7 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
             case DEG_BY:
                 if (!StackEmpty(stack)) {
                     Poly p = StackTop(stack);
-                    printf("%d\n", PolyDegBy(&p, (size_t)line->arg));
+                    WriteAnswer(writer, PolyDegBy(&p, (size_t)line->arg));
                 }
                 else {
                     PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -185,7 +214,7 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
                     Poly p = StackTop(stack);
                     StackPop(stack);
                     StackPush(stack, PolyAt(&p, line->arg));
-                    PolyDestroy(&p);
+                    PolyDestroyDeferred(&p);
                 }
                 else {
                     PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -194,7 +223,8 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
             case PRINT:
                 if (!StackEmpty(stack)) {
                     Poly p = StackTop(stack);
-                    PolyPrint(&p, true);
+                    PolyWrite(&p, writer);
+                    WriteChar(writer, '\n');
                 }
                 else {
                     PrintErrorMsg(lineNr, STACK_UNDERFLOW);
@@ -226,9 +256,9 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
 
                     StackPush(stack, PolyCompose(&p, line->arg, q));
 
-                    PolyDestroy(&p);
+                    PolyDestroyDeferred(&p);
                     for (size_t i = 0; i < (size_t)line->arg; ++i) {
-                        PolyDestroy(&q[i]);
+                        PolyDestroyDeferred(&q[i]);
                     }
                     free(q);
                 }
@@ -238,32 +268,221 @@ static inline void Calc(const Line *line, Stack *stack, size_t lineNr) {
 }
 
 /**
- * Funkcja główna programu, realizuje zadanie kalkulatora przetwarzając kolejne
- * wiersze wejścia.
- * @return 0
+ * Wykonuje poprawny wiersz albo, gdy @p program nie jest NULL, dodaje
+ * wiersz do kompilowanego programu.
+ * @param[in] line : wiersz
+ * @param[in,out] stack : stos
+ * @param[in,out] writer : pisarz standardowego wyjścia
+ * @param[in,out] program : kompilowany program albo NULL
+ * @param[in] lineNr : numer wiersza
  */
-int main() {
-    Stack stack = StackNew();
-    CVector *input = CVectorNew();
+static inline void Process(const Line *line, Stack *stack, Writer *writer,
+                           Program *program, size_t lineNr) {
+    if (program != NULL) {
+        ProgramAddLine(program, line, lineNr);
+    }
+    else if (IsCorrectLine(line)) {
+        Calc(line, stack, writer, lineNr);
+    }
+}
+
+/**
+ * Ustawia liczbę wątków biblioteki wielomianów na podstawie zmiennej
+ * środowiskowej #THREADS_ENV. Niepoprawna lub nieustawiona wartość oznacza
+ * obliczenia na jednym wątku.
+ */
+static void SetThreadsFromEnv(void) {
+    const char *value = getenv(THREADS_ENV);
+    if (value == NULL) {
+        return;
+    }
+
+    char *end;
+    unsigned long count = strtoul(value, &end, 10);
+    if (*value != '\0' && *end == '\0' && count > 1) {
+        PolySetThreads(count);
+    }
+}
+
+/**
+ * Przetwarza kolejne wiersze standardowego wejścia: wykonuje je albo, gdy
+ * @p program nie jest NULL, kompiluje je do programu.
+ * @param[in,out] stack : stos
+ * @param[in,out] writer : pisarz standardowego wyjścia
+ * @param[in,out] program : kompilowany program albo NULL
+ */
+static void RunInput(Stack *stack, Writer *writer, Program *program) {
+    Reader reader = ReaderNew(STDIN_FILENO);
+    Parser parser = ParserNew();
+    CVector *command = CVectorNew();
+    // na terminal odpowiedzi wypisywane są po każdym wierszu, a poza tym
+    // dopiero po zapełnieniu bufora
+    bool interactive = program == NULL && isatty(STDOUT_FILENO);
     size_t lineNr = 1;
     bool isReadEnd = false;
+    bool midLine = false, isCommand = false;
 
     while (!isReadEnd) {
-        isReadEnd = ReadLine(input);
-        if (!CVectorEmpty(input)) {
-            Line line = Parse(input, lineNr);
+        const char *input;
+        size_t length;
+        bool lineEnd;
+
+        isReadEnd = ReadLine(&reader, &input, &length, &lineEnd);
+        if (isReadEnd) {
+            break;
+        }
+
+        if (!midLine && lineEnd) {
+            if (length > 0) {
+                // wiersz leży w buforze czytelnika, więc nie jest kopiowany
+                Line line = Parse(&parser, input, length, lineNr);
+                Process(&line, stack, writer, program, lineNr);
+            }
+            if (interactive) {
+                WriterFlush(writer);
+            }
+            lineNr++;
+            continue;
+        }
+
+        // wiersz nie mieści się w buforze czytelnika: wielomian jest
+        // konwertowany fragment po fragmencie, a polecenie sklejane
+        if (!midLine) {
+            midLine = true;
+            isCommand = isalpha(input[0]);
+            if (!isCommand) {
+                ParsePolyStart(&parser);
+            }
+        }
+
+        if (isCommand) {
+            for (size_t i = 0; i < length; ++i) {
+                CVectorPush(command, input[i]);
+            }
+        }
+        else {
+            ParsePolyPart(&parser, input, length);
+        }
+
+        if (lineEnd) {
+            Line line = isCommand ?
+                        Parse(&parser, command->items, command->size, lineNr) :
+                        ParsePolyEnd(&parser, lineNr);
+            Process(&line, stack, writer, program, lineNr);
+            if (interactive) {
+                WriterFlush(writer);
+            }
+            CVectorClear(command);
+            midLine = false;
+            lineNr++;
+        }
+    }
+
+    ReaderFree(&reader);
+    ParserFree(&parser);
+    CVectorFree(command);
+}
 
-            CVectorClear(input);
+/**
+ * Wykonuje skompilowany program zapisany w pliku @p path. Przed programem
+ * wykonywane są wiersze standardowego wejścia, np. wielomiany, na których
+ * program ma działać. Błędy programu zgłaszane są z numerami wierszy
+ * skompilowanego skryptu.
+ * @param[in] path : ścieżka do pliku z programem
+ * @param[in,out] stack : stos
+ * @param[in,out] writer : pisarz standardowego wyjścia
+ * @return Czy program jest poprawny?
+ */
+static bool RunProgram(const char *path, Stack *stack, Writer *writer) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+
+    Program program;
+    bool loaded = ProgramLoad(&program, file);
+    fclose(file);
+    if (loaded) {
+        RunInput(stack, writer, NULL);
 
+        Line line;
+        size_t lineNr;
+        while (ProgramNext(&program, &line, &lineNr)) {
             if (IsCorrectLine(&line)) {
-                Calc(&line, &stack, lineNr);
+                Calc(&line, stack, writer, lineNr);
             }
+            else {
+                PrintErrorMsg(lineNr, line.msg);
+            }
+        }
+    }
+    ProgramFree(&program);
+
+    return loaded;
+}
+
+/// pisarz standardowego wyjścia, opróżniany także przy wyjściu przez exit()
+static Writer *stdoutWriter = NULL;
+
+/**
+ * Przekazuje do strumienia odpowiedzi zebrane w buforze pisarza
+ * standardowego wyjścia. Jest rejestrowana przez atexit(), żeby wyjście
+ * z programu przez exit(1), np. po nieudanej alokacji pamięci, nie gubiło
+ * wypisanych już odpowiedzi.
+ */
+static void FlushStdoutWriter(void) {
+    if (stdoutWriter != NULL) {
+        WriterFlush(stdoutWriter);
+    }
+}
+
+/**
+ * Funkcja główna programu, realizuje zadanie kalkulatora przetwarzając kolejne
+ * wiersze wejścia. Z opcją #COMPILE_OPTION zamiast wykonywać wiersze,
+ * kompiluje je i wypisuje skompilowany program, a z opcją #RUN_OPTION
+ * wykonuje skompilowany program.
+ * @param[in] argc : liczba argumentów
+ * @param[in] argv : argumenty
+ * @return 0, albo 1 dla złych argumentów, niepoprawnego programu lub
+ *         skryptu z błędnymi wierszami przy kompilacji
+ */
+int main(int argc, char *argv[]) {
+    SetThreadsFromEnv();
+
+    Stack stack = StackNew();
+    Writer writer = WriterNew(stdout);
+    stdoutWriter = &writer;
+    atexit(FlushStdoutWriter);
+    int status = 0;
+
+    if (argc == 1) {
+        RunInput(&stack, &writer, NULL);
+    }
+    else if (argc == 2 && strcmp(argv[1], COMPILE_OPTION) == 0) {
+        Program program = ProgramNew();
+        RunInput(&stack, &writer, &program);
+        ProgramWrite(&program, &writer);
+        // błędy zostały już wypisane, a program powtórzy je przy wykonaniu
+        status = program.errorCount > 0 ? 1 : 0;
+        ProgramFree(&program);
+    }
+    else if (argc == 3 && strcmp(argv[1], RUN_OPTION) == 0) {
+        if (!RunProgram(argv[2], &stack, &writer)) {
+            fprintf(stderr, "ERROR %s\n", WRONG_PROGRAM);
+            status = 1;
         }
-        lineNr++;
+    }
+    else {
+        fprintf(stderr, "usage: %s [%s | %s FILE]\n", argv[0],
+                COMPILE_OPTION, RUN_OPTION);
+        status = 1;
     }
 
+    stdoutWriter = NULL;
+    WriterFree(&writer);
     StackFree(&stack);
-    CVectorFree(input);
+    PolyDestroyWait();
+    PolySetThreads(1);
 
-    return 0;
+    return status;
 }
@@ -0,0 +1,281 @@
+/** @file
+  Implementacja wektorowych jąder arytmetyki na współczynnikach.
+
+  Procesory x86-64 nie mają w AVX2 mnożenia liczb 64-bitowych, więc wersja
+  AVX2 składa je z trzech mnożeń 32-bitowych połówek. AVX-512DQ ma takie
+  mnożenie wprost. Wersje wektorowe są kompilowane z atrybutem @c target,
+  więc cały program nie wymaga nowszego procesora, a wersja wywoływana jest
+  wybierana na podstawie @c __builtin_cpu_supports. Na innych architekturach
+  i kompilatorach zostaje wersja skalarna.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#include "coeff.h"
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/// czy kompilowane są wektorowe wersje jąder
+#define COEFF_X86 1
+#include <immintrin.h>
+#endif
+
+/// najlepszy zestaw instrukcji dozwolony przez CoeffSetMaxIsa(), wspólny
+/// dla wszystkich wątków, dlatego atomowy
+static atomic_int coeffMaxIsa = COEFF_ISA_AVX512;
+
+void CoeffSetMaxIsa(CoeffIsa isa) {
+    atomic_store_explicit(&coeffMaxIsa, isa, memory_order_relaxed);
+}
+
+CoeffIsa CoeffIsaUsed(void) {
+    CoeffIsa max = atomic_load_explicit(&coeffMaxIsa, memory_order_relaxed);
+#ifdef COEFF_X86
+    if (max >= COEFF_ISA_AVX512 && __builtin_cpu_supports("avx512f") &&
+        __builtin_cpu_supports("avx512dq")) {
+        return COEFF_ISA_AVX512;
+    }
+    if (max >= COEFF_ISA_AVX2 && __builtin_cpu_supports("avx2")) {
+        return COEFF_ISA_AVX2;
+    }
+#else
+    (void)max;
+#endif
+    return COEFF_ISA_SCALAR;
+}
+
+/**
+ * Skalarna wersja CoeffAxpy(), dla każdego procesora. Liczy na typie bez
+ * znaku, żeby przepełnienie było zdefiniowane.
+ * @param[in,out] dst : tablica wynikowa
+ * @param[in] src : dodawana tablica
+ * @param[in] n : długość tablic
+ * @param[in] c : mnożnik
+ */
+static void CoeffAxpyScalar(poly_coeff_t *restrict dst,
+                            const poly_coeff_t *restrict src, size_t n,
+                            poly_coeff_t c) {
+    for (size_t i = 0; i < n; ++i) {
+        dst[i] = (poly_coeff_t)((uint64_t)dst[i] +
+                                (uint64_t)c * (uint64_t)src[i]);
+    }
+}
+
+/**
+ * Oblicza @p n-tą potęgę liczby @p x modulo @f$2^{64}@f$.
+ * @param[in] x : podstawa
+ * @param[in] n : wykładnik
+ * @return @f$x^n@f$
+ */
+static inline uint64_t CoeffPow(uint64_t x, poly_exp_t n) {
+    uint64_t res = 1;
+    while (n) {
+        if (n % 2 == 1) {
+            res *= x;
+        }
+        n /= 2;
+        x *= x;
+    }
+    return res;
+}
+
+/**
+ * Skalarna wersja CoeffHorner(), dla każdego procesora.
+ * @param[in] coeffs : współczynniki od najwyższego wykładnika
+ * @param[in] gaps : różnice kolejnych wykładników
+ * @param[in] n : liczba jednomianów
+ * @param[in] x : punkty
+ * @param[out] res : wartości w punktach
+ * @param[in] count : liczba punktów
+ */
+static void CoeffHornerScalar(const poly_coeff_t *coeffs,
+                              const poly_exp_t *gaps, size_t n,
+                              const poly_coeff_t *x, poly_coeff_t *res,
+                              size_t count) {
+    for (size_t k = 0; k < count; ++k) {
+        uint64_t r = 0, xk = (uint64_t)x[k];
+        for (size_t i = 0; i < n; ++i) {
+            r += (uint64_t)coeffs[i];
+            r *= gaps[i] == 1 ? xk : CoeffPow(xk, gaps[i]);
+        }
+        res[k] = (poly_coeff_t)r;
+    }
+}
+
+#ifdef COEFF_X86
+/**
+ * Mnoży liczby 64-bitowe w wektorach AVX2 modulo @f$2^{64}@f$. Iloczyn to
+ * @f$a_l b_l + 2^{32}(a_h b_l + a_l b_h)@f$, gdzie indeksy @f$l@f$
+ * i @f$h@f$ oznaczają młodszą i starszą połowę liczby.
+ * @param[in] a : wektor @f$a@f$
+ * @param[in] b : wektor @f$b@f$
+ * @return @f$a \cdot b@f$
+ */
+__attribute__((target("avx2")))
+static inline __m256i Mul64Avx2(__m256i a, __m256i b) {
+    __m256i low = _mm256_mul_epu32(a, b);
+    __m256i cross = _mm256_add_epi64(
+        _mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+        _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+    return _mm256_add_epi64(low, _mm256_slli_epi64(cross, 32));
+}
+
+/**
+ * Wersja CoeffAxpy() dla AVX2.
+ * @param[in,out] dst : tablica wynikowa
+ * @param[in] src : dodawana tablica
+ * @param[in] n : długość tablic
+ * @param[in] c : mnożnik
+ */
+__attribute__((target("avx2")))
+static void CoeffAxpyAvx2(poly_coeff_t *restrict dst,
+                          const poly_coeff_t *restrict src, size_t n,
+                          poly_coeff_t c) {
+    const __m256i cv = _mm256_set1_epi64x(c);
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m256i prod = Mul64Avx2(
+            _mm256_loadu_si256((const __m256i *)(src + i)), cv);
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_add_epi64(d, prod));
+    }
+    CoeffAxpyScalar(dst + i, src + i, n - i, c);
+}
+
+/**
+ * Wersja CoeffHorner() dla AVX2: cztery punkty w wektorze.
+ * @param[in] coeffs : współczynniki od najwyższego wykładnika
+ * @param[in] gaps : różnice kolejnych wykładników
+ * @param[in] n : liczba jednomianów
+ * @param[in] x : punkty
+ * @param[out] res : wartości w punktach
+ * @param[in] count : liczba punktów
+ */
+__attribute__((target("avx2")))
+static void CoeffHornerAvx2(const poly_coeff_t *coeffs,
+                            const poly_exp_t *gaps, size_t n,
+                            const poly_coeff_t *x, poly_coeff_t *res,
+                            size_t count) {
+    size_t k = 0;
+    for (; k + 4 <= count; k += 4) {
+        const __m256i xv = _mm256_loadu_si256((const __m256i *)(x + k));
+        __m256i r = _mm256_setzero_si256();
+        for (size_t i = 0; i < n; ++i) {
+            r = _mm256_add_epi64(r, _mm256_set1_epi64x(coeffs[i]));
+            if (gaps[i] == 1) {
+                r = Mul64Avx2(r, xv);
+                continue;
+            }
+            // potęga przez podnoszenie do kwadratu, osobno w każdym elemencie
+            __m256i base = xv;
+            for (poly_exp_t g = gaps[i]; g != 0; g /= 2) {
+                if (g % 2 == 1) {
+                    r = Mul64Avx2(r, base);
+                }
+                if (g > 1) {
+                    base = Mul64Avx2(base, base);
+                }
+            }
+        }
+        _mm256_storeu_si256((__m256i *)(res + k), r);
+    }
+    CoeffHornerScalar(coeffs, gaps, n, x + k, res + k, count - k);
+}
+
+/**
+ * Wersja CoeffAxpy() dla AVX-512 z mnożeniem liczb 64-bitowych (AVX-512DQ).
+ * @param[in,out] dst : tablica wynikowa
+ * @param[in] src : dodawana tablica
+ * @param[in] n : długość tablic
+ * @param[in] c : mnożnik
+ */
+__attribute__((target("avx512f,avx512dq")))
+static void CoeffAxpyAvx512(poly_coeff_t *restrict dst,
+                            const poly_coeff_t *restrict src, size_t n,
+                            poly_coeff_t c) {
+    const __m512i cv = _mm512_set1_epi64(c);
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m512i prod = _mm512_mullo_epi64(_mm512_loadu_si512(src + i), cv);
+        __m512i d = _mm512_loadu_si512(dst + i);
+        _mm512_storeu_si512(dst + i, _mm512_add_epi64(d, prod));
+    }
+    CoeffAxpyScalar(dst + i, src + i, n - i, c);
+}
+
+/**
+ * Wersja CoeffHorner() dla AVX-512: osiem punktów w wektorze.
+ * @param[in] coeffs : współczynniki od najwyższego wykładnika
+ * @param[in] gaps : różnice kolejnych wykładników
+ * @param[in] n : liczba jednomianów
+ * @param[in] x : punkty
+ * @param[out] res : wartości w punktach
+ * @param[in] count : liczba punktów
+ */
+__attribute__((target("avx512f,avx512dq")))
+static void CoeffHornerAvx512(const poly_coeff_t *coeffs,
+                              const poly_exp_t *gaps, size_t n,
+                              const poly_coeff_t *x, poly_coeff_t *res,
+                              size_t count) {
+    size_t k = 0;
+    for (; k + 8 <= count; k += 8) {
+        const __m512i xv = _mm512_loadu_si512(x + k);
+        __m512i r = _mm512_setzero_si512();
+        for (size_t i = 0; i < n; ++i) {
+            r = _mm512_add_epi64(r, _mm512_set1_epi64(coeffs[i]));
+            if (gaps[i] == 1) {
+                r = _mm512_mullo_epi64(r, xv);
+                continue;
+            }
+            // potęga przez podnoszenie do kwadratu, osobno w każdym elemencie
+            __m512i base = xv;
+            for (poly_exp_t g = gaps[i]; g != 0; g /= 2) {
+                if (g % 2 == 1) {
+                    r = _mm512_mullo_epi64(r, base);
+                }
+                if (g > 1) {
+                    base = _mm512_mullo_epi64(base, base);
+                }
+            }
+        }
+        _mm512_storeu_si512(res + k, r);
+    }
+    CoeffHornerScalar(coeffs, gaps, n, x + k, res + k, count - k);
+}
+#endif
+
+void CoeffAxpy(poly_coeff_t *restrict dst, const poly_coeff_t *restrict src,
+               size_t n, poly_coeff_t c) {
+    switch (CoeffIsaUsed()) {
+#ifdef COEFF_X86
+        case COEFF_ISA_AVX512:
+            CoeffAxpyAvx512(dst, src, n, c);
+            break;
+        case COEFF_ISA_AVX2:
+            CoeffAxpyAvx2(dst, src, n, c);
+            break;
+#endif
+        default:
+            CoeffAxpyScalar(dst, src, n, c);
+    }
+}
+
+void CoeffHorner(const poly_coeff_t *coeffs, const poly_exp_t *gaps,
+                 size_t n, const poly_coeff_t *x, poly_coeff_t *res,
+                 size_t count) {
+    switch (CoeffIsaUsed()) {
+#ifdef COEFF_X86
+        case COEFF_ISA_AVX512:
+            CoeffHornerAvx512(coeffs, gaps, n, x, res, count);
+            break;
+        case COEFF_ISA_AVX2:
+            CoeffHornerAvx2(coeffs, gaps, n, x, res, count);
+            break;
+#endif
+        default:
+            CoeffHornerScalar(coeffs, gaps, n, x, res, count);
+    }
+}
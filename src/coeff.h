@@ -0,0 +1,84 @@
+/** @file
+  Plik udostępnia wektorowe jądra arytmetyki na spakowanych tablicach
+  współczynników, z których korzysta biblioteka wielomianów.
+
+  Jądra działają na zwykłych tablicach wartości typu poly_coeff_t, a nie na
+  tablicach jednomianów, dlatego wywołujący najpierw pakuje współczynniki do
+  takiej tablicy. Arytmetyka jest modulo @f$2^{64}@f$, tak jak na
+  współczynnikach wielomianów. Wersja jądra (AVX-512, AVX2 albo skalarna)
+  wybierana jest przy każdym wywołaniu na podstawie możliwości procesora,
+  a wynik od niej nie zależy.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#ifndef POLYNOMIALS_COEFF_H
+#define POLYNOMIALS_COEFF_H
+
+#include "poly.h"
+
+#include <stddef.h>
+
+/**
+ * To jest typ wyliczeniowy określający zestaw instrukcji procesora, którego
+ * używają jądra.
+ */
+typedef enum {
+    /** zwykłe instrukcje, bez wektorów */
+    COEFF_ISA_SCALAR,
+    /** wektory 256-bitowe AVX2 */
+    COEFF_ISA_AVX2,
+    /** wektory 512-bitowe AVX-512 z mnożeniem liczb 64-bitowych */
+    COEFF_ISA_AVX512
+} CoeffIsa;
+
+/**
+ * Ogranicza zestaw instrukcji używany przez jądra. Domyślnie jądra używają
+ * najlepszego zestawu obsługiwanego przez procesor. Ustawienie jest wspólne
+ * dla wszystkich wątków i służy do testów.
+ * @param[in] isa : najlepszy dozwolony zestaw instrukcji
+ */
+void CoeffSetMaxIsa(CoeffIsa isa);
+
+/**
+ * Daje zestaw instrukcji, którego używają jądra, czyli najlepszy zestaw
+ * obsługiwany przez procesor i dozwolony przez CoeffSetMaxIsa().
+ * @return zestaw instrukcji
+ */
+CoeffIsa CoeffIsaUsed(void);
+
+/**
+ * Dodaje do tablicy @p dst tablicę @p src pomnożoną przez @p c, czyli
+ * @f$dst_i \gets dst_i + c \cdot src_i@f$ dla @f$i < n@f$. Tablice nie mogą
+ * na siebie nachodzić.
+ * @param[in,out] dst : tablica wynikowa
+ * @param[in] src : dodawana tablica
+ * @param[in] n : długość tablic
+ * @param[in] c : mnożnik
+ */
+void CoeffAxpy(poly_coeff_t *restrict dst, const poly_coeff_t *restrict src,
+               size_t n, poly_coeff_t c);
+
+/**
+ * Wylicza wartości wielomianu jednej zmiennej o współczynnikach będących
+ * liczbami w @p count punktach schematem Hornera, liczonym równolegle dla
+ * wielu punktów, po jednym w każdym elemencie wektora. Wielomian
+ * @f$\sum_i c_i x^{e_i}@f$, gdzie @f$e_0 > e_1 > \ldots > e_{n-1} \ge 0@f$,
+ * jest spakowany w tablice @f$coeffs_i = c_i@f$ oraz
+ * @f$gaps_i = e_i - e_{i+1}@f$, przy czym @f$e_n = 0@f$. Wynik to
+ * @f$(\ldots((c_0 x^{gaps_0} + c_1) x^{gaps_1} + c_2) \ldots + c_{n-1})
+ * x^{gaps_{n-1}}@f$, gdzie potęgi przy lukach między wykładnikami liczone
+ * są przez podnoszenie do kwadratu.
+ * @param[in] coeffs : współczynniki od najwyższego wykładnika
+ * @param[in] gaps : różnice kolejnych wykładników
+ * @param[in] n : liczba jednomianów
+ * @param[in] x : punkty
+ * @param[out] res : wartości w punktach
+ * @param[in] count : liczba punktów
+ */
+void CoeffHorner(const poly_coeff_t *coeffs, const poly_exp_t *gaps,
+                 size_t n, const poly_coeff_t *x, poly_coeff_t *res,
+                 size_t count);
+
+#endif //POLYNOMIALS_COEFF_H
@@ -9,8 +9,8 @@
 #include "poly.h"
 #include <stdbool.h>
 
-Line WrongLine() {
-    return (Line) {.status = ERROR};
+Line WrongLine(const char *msg) {
+    return (Line) {.msg = msg, .status = ERROR};
 }
 
 bool IsCorrectLine(const Line *line) {
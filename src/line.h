@@ -33,9 +33,9 @@ typedef enum {
  */
 typedef struct {
     /**
-     * To jest unia przechowująca wielomian lub strukutrę złożoną z polecenia
-     * i argumentu. Jeżeli polecenie nie ma argumetu to pole `arg` nie jest
-     * używane.
+     * To jest unia przechowująca wielomian, strukutrę złożoną z polecenia
+     * i argumentu albo komunikat błędu. Jeżeli polecenie nie ma argumetu to
+     * pole `arg` nie jest używane.
      */
     union {
         Poly p; ///< wielomian
@@ -43,6 +43,7 @@ typedef struct {
             Command c; ///< polecenie
             poly_coeff_t arg; ///< argument polecenia DEG_BY lub AT
         };
+        const char *msg; ///< komunikat błędu niepoprawnego wiersza
     };
     LineStatus status; ///< status wiersza
 } Line;
@@ -50,9 +51,10 @@ typedef struct {
 /**
  * Zwraca niepoprawny wiersz reprezentujący sytuację kiedy na wejściu użytkownik
  * wprowadził nieprawidłową komendę lub wielomian.
+ * @param[in] msg : komunikat błędu
  * @return niepoprawny wiersz
  */
-Line WrongLine();
+Line WrongLine(const char *msg);
 
 /**
  * Sprawdza czy wiersz jest poprawny.
@@ -7,13 +7,14 @@
 
 #include "parse.h"
 #include "line.h"
+#include "pool.h"
 #include "vector.h"
 
 #include <assert.h>
 #include <ctype.h>
-#include <errno.h>
 #include <limits.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -41,62 +42,52 @@
 #define WRONG_POLY "WRONG POLY"
 
 /**
- * Sprawdza czy @p pre jest prefiksem @p str.
+ * Sprawdza czy @p pre jest prefiksem wiersza @p str.
  * @param[in] pre : łańcuch znaków
- * @param[in] str : łańcuch znaków
+ * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
  * @return Czy @p pre jest prefiksem @p str?
  */
-static inline bool IsPrefix(const char *pre, const char *str) {
-    return strncmp(pre, str, strlen(pre)) == 0;
+static inline bool IsPrefix(const char *pre, const char *str, size_t length) {
+    size_t len = strlen(pre);
+    return length >= len && memcmp(pre, str, len) == 0;
 }
 
 /**
- * Sprawdza czy @p cv zawiera poprawne polecenie DEG_BY lub AT, tzn. czy @p str
- * jest prefiksem @p cv oraz czy następny znak @p cv jest znakiem białym lub
- * '\0'.
- * @param[in] cv : wektor znaków
- * @param[in] str : łańcuch znaków
+ * Sprawdza czy wiersz @p str zawiera poprawne polecenie DEG_BY lub AT, tzn.
+ * czy @p cmd jest prefiksem @p str oraz czy następny znak @p str jest znakiem
+ * białym lub wiersz się na nim kończy.
+ * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] cmd : łańcuch znaków
  * @return Czy polecenie jest poprawne?
  */
-static inline bool IsCorrectCommand(const CVector *cv, const char *str) {
-    size_t len = strlen(str);
-    return IsPrefix(str, cv->items) &&
-        ((cv->size > len && isspace(cv->items[len])) ||
-        (cv->size - 1 == len && cv->items[len] == '\0'));
+static inline bool IsCorrectCommand(const char *str, size_t length,
+                                    const char *cmd) {
+    size_t len = strlen(cmd);
+    return IsPrefix(cmd, str, length) &&
+        (length == len || isspace(str[len]));
 }
 
 /**
- * Sprawdza, wektor znaków @p cv jest równy z łańcuchem @p str.
- * @param[in] cv : wektor znaków zakończony '\0'
- * @param[in] str : łańcuch znaków
+ * Sprawdza, czy wiersz @p str jest równy z łańcuchem @p cmd.
+ * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
+ * @param[in] cmd : łańcuch znaków
  * @return Czy są równe?
  */
-static inline bool IsEqual(const CVector *cv, const char *str) {
-    return cv->size == strlen(str) + 1 && strcmp(cv->items, str) == 0;
+static inline bool IsEqual(const char *str, size_t length, const char *cmd) {
+    return length == strlen(cmd) && memcmp(str, cmd, length) == 0;
 }
 
 /**
- * Sprawdza czy @p c jest dozwolonym znakiem w wielomianie.
+ * Sprawdza czy @p c jest cyfrą. W odróżnieniu od isdigit() nie zależy od
+ * lokalizacji, więc kompilator zamienia ją na jedno porównanie.
  * @param[in] c : znak
- * @return Czy @p c jest dozwolonym znakiem w wielomianie?
- */
-static inline bool IsLegalCaracter(char c) {
-    return isdigit(c) || c == '-' || c == '+' || c == '(' || c == ')' ||
-        c == ',';
-}
-
-/**
- * Sprawdza czy wiersz zawiera niedozwolone dla wielomianu znaki.
- * @param[in] str : wiersz
- * @return Czy wiersz zawiera niedozwolone dla wielomianu znaki?
+ * @return Czy @p c jest cyfrą?
  */
-static bool HasIllegalCharacters(const CVector *str) {
-    for (size_t i = 0; i < str->size - 1; ++i) {
-        if (!IsLegalCaracter(str->items[i])) {
-            return true;
-        }
-    }
-    return false;
+static inline bool IsDigit(char c) {
+    return (unsigned char)(c - '0') < 10;
 }
 
 /**
@@ -105,340 +96,805 @@ static bool HasIllegalCharacters(const CVector *str) {
  * @return Czy @p c jest cyfrą lub znakiem '-'?
  */
 static inline bool IsDigitOrMinus(char c) {
-    return isdigit(c) || c == '-';
-}
-
-/**
- * Sprawdza, czy wyrażenie jest porawnie nawiasowane.
- * @param s : wyrażenie
- * @return Czy wyrażenie jest porawnie nawiasowane?
- */
-static bool AreParenthesesValid(const char *s) {
-    int ctr = 0;
-
-    while (*s && ctr >= 0) {
-        if (*s == '(') {
-            ctr++;
-        }
-        else if (*s == ')') {
-            ctr--;
-        }
-        s++;
-    }
-
-    return ctr == 0;
+    return IsDigit(c) || c == '-';
 }
 
 /**
  * Sprawdza czy polecenie DEG_BY zawiera argument.
  * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
  * @return Czy polecenie DEG_BY zawiera argument?
  */
-static inline bool HasDegByAnArgument(const CVector *str) {
-    return str->size >= 8 && str->items[6] == ' ' && isdigit(str->items[7]);
+static inline bool HasDegByAnArgument(const char *str, size_t length) {
+    return length >= 8 && str[6] == ' ' && isdigit(str[7]);
 }
 
 /**
  * Sprawdza czy polecenie COMPOSE zawiera argument.
  * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
  * @return Czy polecenie COMPOSE zawiera argument?
  */
-static inline bool HasComposeAnArgument(const CVector *str) {
-    return str->size >= 9 && str->items[7] == ' ' && isdigit(str->items[8]);
+static inline bool HasComposeAnArgument(const char *str, size_t length) {
+    return length >= 9 && str[7] == ' ' && isdigit(str[8]);
 }
 
 /**
  * Sprawdza czy polecenie AT zawiera argument.
  * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
  * @return Czy polecenie AT zawiera argument?
  */
-static inline bool HasAtAnArgument(const CVector *str) {
-    return str->size >= 4 && str->items[2] == ' ' &&
-            IsDigitOrMinus(str->items[3]);
+static inline bool HasAtAnArgument(const char *str, size_t length) {
+    return length >= 4 && str[2] == ' ' && IsDigitOrMinus(str[3]);
 }
 
 /**
- * Sprawdza, czy nastąpił błąd podczas konwersji argumentu. Za błąd uznaję
- * argument spoza zakresu lub dodatkowe znaki po argumencie.
- * @param[in] str : wiersz
- * @param[in] end : wskaźnik na znak, na którym zakończyła się konwersja.
- * @return Czy nastąpił błąd podczas konwersji?
+ * Konwertuje liczbę nieujemną zapisaną dziesiętnie, tak jak strtoull(), ale
+ * nie czyta znaków od @p limit, więc wiersz nie musi kończyć się znakiem
+ * '\0'. Cyfry są zamieniane na liczbę na bieżąco, a przekroczenie zakresu
+ * wykrywa przepełnienie przy mnożeniu i dodawaniu zamiast errno. Funkcja
+ * wczytuje wszystkie cyfry, a gdy liczba przekracza @p max, ustawia
+ * @p outOfRange na true.
+ * @param[in] begin : początek liczby
+ * @param[in] limit : koniec wiersza
+ * @param[in] max : największa dopuszczalna wartość
+ * @param[out] value : wartość liczby
+ * @param[out] outOfRange : czy liczba przekracza @p max
+ * @return wskaźnik na pierwszy znak po liczbie (@p begin, gdy nie ma cyfr)
+ */
+static inline const char *ParseUnsigned(const char *begin, const char *limit,
+                                        uint64_t max, uint64_t *value,
+                                        bool *outOfRange) {
+    uint64_t x = 0;
+    bool overflow = false;
+
+    for (; begin < limit && IsDigit(*begin); ++begin) {
+        overflow |= __builtin_mul_overflow(x, 10, &x);
+        overflow |= __builtin_add_overflow(x, (uint64_t)(*begin - '0'), &x);
+    }
+
+    *value = x;
+    *outOfRange = overflow || x > max;
+    return begin;
+}
+
+/**
+ * Konwertuje liczbę całkowitą zapisaną dziesiętnie, być może poprzedzoną
+ * znakiem '-', tak jak strtoll(), ale nie czyta znaków od @p limit.
+ * @param[in] begin : początek liczby
+ * @param[in] limit : koniec wiersza
+ * @param[out] value : wartość liczby
+ * @param[out] outOfRange : czy liczba wykracza poza zakres typu long long
+ * @return wskaźnik na pierwszy znak po liczbie (@p begin, gdy nie ma cyfr)
  */
-static inline bool ArgumentError(const CVector *str, const char *end) {
-    return errno == ERANGE || *end != '\0' ||
-            (size_t)(end - str->items) != str->size - 1;
+static inline const char *ParseSigned(const char *begin, const char *limit,
+                                      long long *value, bool *outOfRange) {
+    bool negative = begin < limit && *begin == '-';
+    uint64_t x;
+    const char *end = ParseUnsigned(begin + negative, limit,
+                                    (uint64_t)LLONG_MAX + negative, &x,
+                                    outOfRange);
+
+    if (end == begin + negative) {
+        *value = 0;
+        return begin;
+    }
+
+    *value = negative ? (long long)(0 - x) : (long long)x;
+    return end;
 }
 
 /**
  * Konwertuje wiersz na obiekt typu \ref Line reprezentujący wiersz zawierający
  * polecenie.
  * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
  * @param[in] lineNr : numer linii
  * @return skonwertowany wiersz
  */
-static Line ParseCommand(const CVector *str, size_t lineNr) {
-    if (IsEqual(str, "ZERO")) {
+static Line ParseCommand(const char *str, size_t length, size_t lineNr) {
+    if (IsEqual(str, length, "ZERO")) {
         return CommandLine(ZERO);
     }
-    if (IsEqual(str, "IS_COEFF")) {
+    if (IsEqual(str, length, "IS_COEFF")) {
         return CommandLine(IS_COEFF);
     }
-    if (IsEqual(str, "IS_ZERO")) {
+    if (IsEqual(str, length, "IS_ZERO")) {
         return CommandLine(IS_ZERO);
     }
-    if (IsEqual(str, "CLONE")) {
+    if (IsEqual(str, length, "CLONE")) {
         return CommandLine(CLONE);
     }
-    if (IsEqual(str, "ADD")) {
+    if (IsEqual(str, length, "ADD")) {
         return CommandLine(ADD);
     }
-    if (IsEqual(str, "MUL")) {
+    if (IsEqual(str, length, "MUL")) {
         return CommandLine(MUL);
     }
-    if (IsEqual(str, "NEG")) {
+    if (IsEqual(str, length, "NEG")) {
         return CommandLine(NEG);
     }
-    if (IsEqual(str, "SUB")) {
+    if (IsEqual(str, length, "SUB")) {
         return CommandLine(SUB);
     }
-    if (IsEqual(str, "IS_EQ")) {
+    if (IsEqual(str, length, "IS_EQ")) {
         return CommandLine(IS_EQ);
     }
-    if (IsEqual(str, "DEG")) {
+    if (IsEqual(str, length, "DEG")) {
         return CommandLine(DEG);
     }
-    if (IsEqual(str, "PRINT")) {
+    if (IsEqual(str, length, "PRINT")) {
         return CommandLine(PRINT);
     }
-    if (IsEqual(str, "POP")) {
+    if (IsEqual(str, length, "POP")) {
         return CommandLine(POP);
     }
-    if (IsCorrectCommand(str, "DEG_BY")) {
-        if (HasDegByAnArgument(str)) {
-            char *end;
-            errno = 0;
-            size_t arg = strtoull(str->items + 7, &end, 10);
-
-            if (ArgumentError(str, end)) {
+    if (IsCorrectCommand(str, length, "DEG_BY")) {
+        if (HasDegByAnArgument(str, length)) {
+            uint64_t arg;
+            bool outOfRange;
+            const char *end = ParseUnsigned(str + 7, str + length, SIZE_MAX,
+                                            &arg, &outOfRange);
+
+            if (outOfRange || end != str + length) {
                 PrintErrorMsg(lineNr, DEG_BY_WRONG_VARIABLE);
-                return WrongLine();
+                return WrongLine(DEG_BY_WRONG_VARIABLE);
             }
 
             return CommandLineWithArg(DEG_BY, arg);
         }
         else {
             PrintErrorMsg(lineNr, DEG_BY_WRONG_VARIABLE);
-            return WrongLine();
+            return WrongLine(DEG_BY_WRONG_VARIABLE);
         }
     }
-    if (IsCorrectCommand(str, "AT")) {
-        if (HasAtAnArgument(str)) {
-            char *end;
-            errno = 0;
-            poly_coeff_t arg = strtoll(str->items + 3, &end, 10);
-
-            if (ArgumentError(str, end)) {
+    if (IsCorrectCommand(str, length, "AT")) {
+        if (HasAtAnArgument(str, length)) {
+            long long arg;
+            bool outOfRange;
+            const char *end = ParseSigned(str + 3, str + length, &arg,
+                                          &outOfRange);
+
+            if (outOfRange || end != str + length) {
                 PrintErrorMsg(lineNr, AT_WRONG_VALUE);
-                return WrongLine();
+                return WrongLine(AT_WRONG_VALUE);
             }
 
             return CommandLineWithArg(AT, arg);
         }
         else {
             PrintErrorMsg(lineNr, AT_WRONG_VALUE);
-            return WrongLine();
+            return WrongLine(AT_WRONG_VALUE);
         }
     }
-    if (IsCorrectCommand(str, "COMPOSE")) {
-        if (HasComposeAnArgument(str)) {
-            char *end;
-            errno = 0;
-            size_t arg = strtoull(str->items + 8, &end, 10);
-
-            if (ArgumentError(str, end)) {
+    if (IsCorrectCommand(str, length, "COMPOSE")) {
+        if (HasComposeAnArgument(str, length)) {
+            uint64_t arg;
+            bool outOfRange;
+            const char *end = ParseUnsigned(str + 8, str + length, SIZE_MAX,
+                                            &arg, &outOfRange);
+
+            if (outOfRange || end != str + length) {
                 PrintErrorMsg(lineNr, COMPOSE_WRONG_PARAMETER);
-                return WrongLine();
+                return WrongLine(COMPOSE_WRONG_PARAMETER);
             }
 
             return CommandLineWithArg(COMPOSE, arg);
         }
         else {
             PrintErrorMsg(lineNr, COMPOSE_WRONG_PARAMETER);
-            return WrongLine();
+            return WrongLine(COMPOSE_WRONG_PARAMETER);
         }
     }
 
     PrintErrorMsg(lineNr, WRONG_COMMAND);
-    return WrongLine();
+    return WrongLine(WRONG_COMMAND);
+}
+
+/// początkowa liczba wektorów w puli parsera
+#define INITIAL_PARSER_LEVELS 8
+
+/// początkowy rozmiar tablicy jednomianów poziomu parsera
+#define INITIAL_PARSER_MONOS 4
+
+/// najmniejsza liczba jednomianów, od której wynik przejmuje tablicę poziomu
+/// parsera; mniejsze tablice taniej jest skopiować i zostawić w puli
+#define PARSER_HANDOFF_MIN 16
+
+Parser ParserNew(void) {
+    return (Parser) {.state = PARSER_POLY};
+}
+
+void ParserFree(Parser *self) {
+    for (size_t i = 0; i < self->allocated; ++i) {
+        if (self->levels[i].monos.items != NULL) {
+            PolyMonosFree(self->levels[i].monos.items);
+        }
+    }
+    free(self->levels);
+    self->levels = NULL;
+    self->allocated = 0;
 }
 
 /**
- * Konwertuje wykładnik jednomianu. Funkcja ustawia @p end na pierwszy znak po
- * skonwertowanym fragmencie (dla poprawnego jednomianu jest to ')').
- * Funkcja ustawia @p err na true jeżeli @p begin nie wskazuje na cyfrę lub gdy
- * wykładnik wykracza poza zakres lub gdy po wykładniku nie stoi znak ')'.
- * @param[in] begin : początek wykładnika
- * @param[out] end : wskaźnik na pierwszy znak po skonwertowanym fragmencie
- * @param[out] err : flaga błędu
- * @return wykładnik
+ * Otwiera kolejny poziom zagnieżdżenia, czyli sumę jednomianów. Poziom
+ * dostaje wektor z puli, a pula rośnie, gdy zagnieżdżenie jest głębsze niż
+ * dotychczas.
+ * @param[in,out] self : parser
  */
-static int ParseExp(char *begin, char **end, bool *err) {
-    if (!isdigit(*begin)) {
-        *err = true;
-        return 0;
+static inline void ParserPush(Parser *self) {
+    if (self->depth == self->allocated) {
+        size_t allocated = self->allocated == 0 ?
+                           INITIAL_PARSER_LEVELS : 2 * self->allocated;
+        self->levels = realloc(self->levels,
+                               allocated * sizeof (ParserLevel));
+        CHECK_PTR(self->levels);
+        for (size_t i = self->allocated; i < allocated; ++i) {
+            self->levels[i] = (ParserLevel) {.monos = MVectorNew()};
+        }
+        self->allocated = allocated;
     }
 
-    errno = 0;
-    long x = strtol(begin, end, 10);
+    ParserLevel *level = &self->levels[self->depth++];
+    level->monos.size = 0;
+    level->sorted = true;
+}
 
-    if (errno == ERANGE || **end != ')' || x > (long)INT_MAX) {
-        *err = true;
-        return 0;
+/**
+ * Dodaje jednomian do najgłębszego poziomu zagnieżdżenia i sprawdza, czy
+ * jednomiany poziomu są nadal w postaci kanonicznej. Tablica poziomu jest
+ * alokowana przez PolyMonosNew(), żeby wynik mógł ją przejąć.
+ * @param[in,out] self : parser
+ * @param[in] m : jednomian
+ */
+static inline void ParserPushMono(Parser *self, Mono m) {
+    ParserLevel *level = &self->levels[self->depth - 1];
+    MVector *monos = &level->monos;
+
+    if (monos->size == monos->allocated) {
+        size_t allocated = monos->allocated == 0 ?
+                           INITIAL_PARSER_MONOS : 2 * monos->allocated;
+        monos->items = monos->items == NULL ?
+                       PolyMonosNew(allocated) :
+                       PolyMonosResize(monos->items, allocated);
+        monos->allocated = allocated;
     }
 
-    return x;
+    level->sorted = level->sorted && !PolyIsZero(&m.p) &&
+        (monos->size == 0 || monos->items[monos->size - 1].exp < m.exp);
+    monos->items[monos->size++] = m;
 }
 
-static Poly ParsePolyHelper(char *begin, char **end, bool *err);
-
 /**
- * Konwertuje jednomian. Funkcja ustawia @p end na pierwszy znak po
- * skonwertowanym fragmencie (dla poprawnego jednomianu jest to ')').
- * Funkcja ustawia @p err na true jeżeli @p begin nie wskazuje na '\0' lub gdy
- * jednomian jest niepoprawny.
- * @param[in] begin : początek jednomianu (pierwszy znak po '(')
- * @param[out] end : wskaźnik na pierwszy znak po skonwertowanym fragmencie
- * @param[out] err : flaga błędu
- * @return jednomian
+ * Zamyka najgłębszy poziom zagnieżdżenia i tworzy wielomian będący sumą jego
+ * jednomianów. Jednomiany w postaci kanonicznej, np. wypisane przez
+ * PolyPrint(), nie wymagają sortowania ani sumowania, więc wynik przejmuje
+ * tablicę poziomu, a poziom dostanie nową przy następnym użyciu. W przeciwnym
+ * razie jednomiany są sumowane przez PolyAddMonos(), a wektor wraca do puli.
+ * @param[in,out] self : parser
+ * @return suma jednomianów poziomu
  */
-static Mono ParseMono(char *begin, char **end, bool *err) {
-    if (*begin == '\0') {
-        *err = true;
-        return (Mono) {};
+static inline Poly ParserPop(Parser *self) {
+    ParserLevel *level = &self->levels[--self->depth];
+
+    if (level->sorted && level->monos.size >= PARSER_HANDOFF_MIN) {
+        Poly p = PolyOwnSortedMonos(level->monos.size, level->monos.items);
+        level->monos = MVectorNew();
+        return p;
     }
 
-    Poly p;
+    if (level->sorted) {
+        Mono *arr = PolyMonosNew(level->monos.size);
+        memcpy(arr, level->monos.items, level->monos.size * sizeof (Mono));
+        return PolyOwnSortedMonos(level->monos.size, arr);
+    }
 
-    p = ParsePolyHelper(begin, end, err);
-    if (*err) {
-        return (Mono) {};
+    return PolyAddMonos(level->monos.size, level->monos.items);
+}
+
+/**
+ * Przerywa konwersję niepoprawnego wielomianu i zwalnia wszystkie
+ * skonwertowane już jego części. Wektory zostają w puli.
+ * @param[in,out] self : parser
+ * @return false
+ */
+static bool ParserFail(Parser *self) {
+    if (self->state == PARSER_EXP_START || self->state == PARSER_EXP) {
+        PolyDestroy(&self->inner);
     }
 
-    if (**end == '\0') {
-        *err = true;
-        PolyDestroy(&p);
-        return (Mono) {};
+    for (size_t i = 0; i < self->depth; ++i) {
+        MVector *monos = &self->levels[i].monos;
+        for (size_t j = 0; j < monos->size; ++j) {
+            MonoDestroy(&monos->items[j]);
+        }
     }
-    // teraz *end wskazuje na ','
 
-    int exp = ParseExp((*end) + 1, end, err);
-    if (*err) {
-        PolyDestroy(&p);
-        return (Mono) {};
+    self->depth = 0;
+    self->state = PARSER_ERROR;
+    return false;
+}
+
+/**
+ * Wczytuje cyfry liczby od @p begin do @p limit i dopisuje je do
+ * wczytywanej przez parser liczby. Przepełnienie jest zapamiętywane, a cyfry
+ * dalej wczytywane, tak jak robi to ParseUnsigned().
+ * @param[in,out] self : parser
+ * @param[in] begin : pierwszy znak
+ * @param[in] limit : koniec fragmentu
+ * @return wskaźnik na pierwszy znak niebędący cyfrą lub @p limit
+ */
+static inline const char *ParserDigits(Parser *self, const char *begin,
+                                       const char *limit) {
+    uint64_t x = self->value;
+    bool overflow = self->overflow;
+
+    for (; begin < limit && IsDigit(*begin); ++begin) {
+        overflow |= __builtin_mul_overflow(x, 10, &x);
+        overflow |= __builtin_add_overflow(x, (uint64_t)(*begin - '0'), &x);
     }
 
-    return MonoFromPoly(&p, exp);
+    self->value = x;
+    self->overflow = overflow;
+    return begin;
 }
 
 /**
- * Konwertuje wielomian. Poprawny wielomian zaczyna się znakiem '(', cyfrą lub
- * znakiem '-'.
- * Funkcja ustawia @p end na pierwszy znak po
- * skonwertowanym fragmencie (dla poprawnego wielomianu jest to '\0' lub ',').
- * Funkcja ustawia @p err na true jeżeli @p begin nie wskazuje na '\0' lub gdy
- * wielomian jest niepoprawny.
- * @param[in] begin : początek wielomianu
- * @param[out] end : wskaźnik na pierwszy znak po skonwertowanym fragmencie
- * @param[out] err : flaga błędu
- * @return wielomian
+ * Zaczyna wczytywanie liczby.
+ * @param[in,out] self : parser
+ * @param[in] negative : czy liczba jest ujemna
+ * @param[in] state : stan, w którym wczytywana jest liczba
  */
-static Poly ParsePolyHelper(char *begin, char **end, bool *err) {
-    if (*begin == '\0') {
-        *err = true;
-        return (Poly) {};
+static inline void ParserStartNumber(Parser *self, bool negative,
+                                     ParserState state) {
+    self->value = 0;
+    self->negative = negative;
+    self->overflow = false;
+    self->state = state;
+}
+
+/**
+ * Sprawdza, czy wczytany współczynnik mieści się w zakresie typu long long,
+ * i tworzy z niego wielomian.
+ * @param[in] self : parser
+ * @param[out] p : wielomian będący współczynnikiem
+ * @return Czy współczynnik jest poprawny?
+ */
+static inline bool ParserCoeff(const Parser *self, Poly *p) {
+    if (self->overflow || self->value > (uint64_t)LLONG_MAX + self->negative) {
+        return false;
     }
 
-    if (IsDigitOrMinus(*begin)) { // parsowany wielomian jest współczynnikiem
-        errno = 0;
-        poly_coeff_t x = strtoll(begin, end, 10);
-        if (errno == ERANGE || (**end != ',' && **end != '\0')) {
-            *err = true;
+    *p = PolyFromCoeff(self->negative ? (poly_coeff_t)(0 - self->value) :
+                                        (poly_coeff_t)self->value);
+    return true;
+}
+
+/**
+ * Przygotowuje parser do konwersji nowego wielomianu.
+ * @param[in,out] self : parser
+ */
+static inline void ParserStart(Parser *self) {
+    self->depth = 0;
+    self->state = PARSER_POLY;
+}
+
+/**
+ * Przetwarza kolejny fragment wielomianu. Wielomian może być podany w wielu
+ * fragmentach, a parser pamięta między nimi stan automatu.
+ * Poprawny wielomian to współczynnik, czyli cyfry poprzedzone być może
+ * znakiem '-', albo suma jednomianów "(p,n)" połączonych znakiem '+', gdzie
+ * p jest wielomianem, a n wykładnikiem złożonym z cyfr. Wielomian
+ * najwyższego poziomu kończy się wraz z wierszem, a wielomian w jednomianie
+ * znakiem ','.
+ * @param[in,out] self : parser
+ * @param[in] str : fragment wielomianu
+ * @param[in] length : długość fragmentu
+ * @return Czy fragment może być częścią poprawnego wielomianu?
+ */
+static bool ParserFeed(Parser *self, const char *str, size_t length) {
+    const char *limit = str + length;
+
+    while (str < limit) {
+        switch (self->state) {
+            case PARSER_POLY:
+                if (*str == '(') { // wielomian jest sumą jednomianów
+                    ParserPush(self);
+                    str++;
+                }
+                else if (*str == '-') {
+                    ParserStartNumber(self, true, PARSER_SIGN);
+                    str++;
+                }
+                else if (IsDigit(*str)) {
+                    ParserStartNumber(self, false, PARSER_COEFF);
+                }
+                else {
+                    return ParserFail(self);
+                }
+                break;
+            case PARSER_SIGN:
+                if (!IsDigit(*str)) {
+                    return ParserFail(self);
+                }
+                self->state = PARSER_COEFF;
+                break;
+            case PARSER_COEFF:
+                str = ParserDigits(self, str, limit);
+                if (str == limit) { // liczba może mieć cyfry w dalszej części
+                    break;
+                }
+                if (self->depth == 0 || *str != ',' ||
+                    !ParserCoeff(self, &self->inner)) {
+                    return ParserFail(self);
+                }
+                self->state = PARSER_EXP_START;
+                str++;
+                break;
+            case PARSER_EXP_START:
+                if (!IsDigit(*str)) {
+                    return ParserFail(self);
+                }
+                ParserStartNumber(self, false, PARSER_EXP);
+                break;
+            case PARSER_EXP:
+                str = ParserDigits(self, str, limit);
+                if (str == limit) {
+                    break;
+                }
+                if (*str != ')' || self->overflow || self->value > INT_MAX) {
+                    return ParserFail(self);
+                }
+                ParserPushMono(self, MonoFromPoly(&self->inner, self->value));
+                self->state = PARSER_AFTER_MONO;
+                str++;
+                break;
+            case PARSER_AFTER_MONO:
+                if (*str == '+') {
+                    self->state = PARSER_MONO;
+                }
+                else if (*str == ',' && self->depth > 1) {
+                    // koniec sumy będącej wielomianem w jednomianie
+                    self->inner = ParserPop(self);
+                    self->state = PARSER_EXP_START;
+                }
+                else {
+                    return ParserFail(self);
+                }
+                str++;
+                break;
+            case PARSER_MONO:
+                if (*str != '(') {
+                    return ParserFail(self);
+                }
+                self->state = PARSER_POLY;
+                str++;
+                break;
+            case PARSER_ERROR:
+                return false;
         }
-        return PolyFromCoeff(x);
     }
-    else { // parsowany wielomian jest jednomianem lub sumą jednomianów
-        MVector monos = MVectorNew();
 
-        while (true) {
-            if (*begin != '(') {
-                *err = true;
-                MVectorDeepFree(&monos);
-                return (Poly) {};
-            }
+    return true;
+}
 
-            Mono m = ParseMono(begin + 1, end, err);
-            if (*err) {
-                MVectorDeepFree(&monos);
-                return (Poly) {};
-            }
-            MVectorPush(&monos, m);
+/**
+ * Kończy konwersję wielomianu po jego ostatnim fragmencie.
+ * @param[in,out] self : parser
+ * @param[out] p : skonwertowany wielomian
+ * @return Czy wielomian jest poprawny?
+ */
+static bool ParserFinish(Parser *self, Poly *p) {
+    if (self->state == PARSER_COEFF && self->depth == 0) {
+        if (!ParserCoeff(self, p)) {
+            return ParserFail(self);
+        }
+    }
+    else if (self->state == PARSER_AFTER_MONO && self->depth == 1) {
+        *p = ParserPop(self);
+    }
+    else {
+        return ParserFail(self);
+    }
+
+    self->state = PARSER_POLY;
+    return true;
+}
 
-            // po wyjściu z ParseMono *end wskazuje na ')' kończący jednomian
-            (*end)++;
+/// najmniejsza długość wiersza z wielomianem, od której jest on konwertowany
+/// równolegle
+#define PARSE_PAR_MIN_LENGTH ((size_t)1 << 20)
 
-            if (**end == '\0' || **end == ',') { // poprawny koniec wielomianu
-                break;
-            }
+/// liczba fragmentów wiersza na jeden wątek przy równoległej konwersji
+#define PARSE_PAR_CHUNKS_PER_THREAD 4
 
-            if (**end != '+') { // niepoprawna suma jednomianów
-                *err = true;
-                MVectorDeepFree(&monos);
-                return (Poly) {};
-            }
+/**
+ * To jest struktura grupy kolejnych jednomianów najwyższego poziomu
+ * wielomianu, konwertowanej w osobnym zadaniu.
+ */
+typedef struct {
+    size_t begin; ///< początek grupy w wierszu
+    size_t end; ///< koniec grupy w wierszu, czyli '+' lub koniec wiersza
+    Mono *monos; ///< jednomiany grupy w tablicy z PolyMonosNew()
+    size_t size; ///< liczba jednomianów grupy
+    bool sorted; ///< czy jednomiany grupy są w postaci kanonicznej
+    bool ok; ///< czy grupa jest poprawna
+    Poly sum; ///< suma jednomianów grupy
+} ParseGroup;
+
+/**
+ * To jest struktura zadania równoległej konwersji wielomianu.
+ */
+typedef struct {
+    const char *str; ///< wiersz
+    size_t length; ///< długość wiersza
+    size_t chunks; ///< liczba fragmentów wiersza
+    ptrdiff_t *depth; ///< zmiana głębokości nawiasów we fragmentach
+    size_t *plus; ///< pierwszy '+' najwyższego poziomu we fragmentach
+    ParseGroup *groups; ///< grupy jednomianów
+} ParseTask;
+
+/**
+ * Daje początek fragmentu wiersza o numerze @p i.
+ * @param[in] task : zadanie
+ * @param[in] i : numer fragmentu
+ * @return początek fragmentu
+ */
+static inline size_t ParseChunkBegin(const ParseTask *task, size_t i) {
+    return task->length / task->chunks * i +
+           (i < task->length % task->chunks ? i : task->length % task->chunks);
+}
+
+/**
+ * Liczy, o ile zmienia się głębokość nawiasów we fragmencie wiersza.
+ * @param[in,out] arg : zadanie
+ * @param[in] i : numer fragmentu
+ */
+static void ParseDepthChunk(void *arg, size_t i) {
+    ParseTask *task = arg;
+    const char *s = task->str + ParseChunkBegin(task, i);
+    const char *end = task->str + ParseChunkBegin(task, i + 1);
+    ptrdiff_t depth = 0;
+
+    for (; s < end; ++s) {
+        depth += (*s == '(') - (*s == ')');
+    }
+    task->depth[i] = depth;
+}
 
-            begin = (*end) + 1;
+/**
+ * Szuka we fragmencie wiersza pierwszego znaku '+' na głębokości 0, znając
+ * głębokość na początku fragmentu. Gdy go nie ma, zapisuje długość wiersza.
+ * @param[in,out] arg : zadanie
+ * @param[in] i : numer fragmentu
+ */
+static void ParsePlusChunk(void *arg, size_t i) {
+    ParseTask *task = arg;
+    size_t begin = ParseChunkBegin(task, i), end = ParseChunkBegin(task, i + 1);
+    ptrdiff_t depth = task->depth[i];
+
+    task->plus[i] = task->length;
+    for (size_t j = begin; j < end; ++j) {
+        char c = task->str[j];
+        if (c == '+' && depth == 0) {
+            task->plus[i] = j;
+            return;
         }
+        depth += (c == '(') - (c == ')');
+    }
+}
 
-        Poly p = PolyAddMonos(monos.size, monos.items);
+/**
+ * Konwertuje grupę jednomianów, czyli fragment postaci "m+m+...+m", gdzie
+ * m jest jednomianem. Jednomiany trafiają do grupy bez sumowania.
+ * @param[in,out] arg : zadanie
+ * @param[in] i : numer grupy
+ */
+static void ParseGroupChunk(void *arg, size_t i) {
+    ParseTask *task = arg;
+    ParseGroup *g = &task->groups[i];
+    Parser parser = ParserNew();
+
+    ParserStart(&parser);
+    g->ok = ParserFeed(&parser, task->str + g->begin, g->end - g->begin) &&
+            parser.state == PARSER_AFTER_MONO && parser.depth == 1;
+
+    if (g->ok) {
+        ParserLevel *level = &parser.levels[0];
+        g->monos = level->monos.items;
+        g->size = level->monos.size;
+        g->sorted = level->sorted;
+        level->monos = MVectorNew();
+    }
+    else if (parser.state != PARSER_ERROR) {
+        ParserFail(&parser);
+    }
 
-        MVectorFree(&monos);
+    ParserFree(&parser);
+}
 
-        return p;
+/**
+ * Sumuje jednomiany grupy, która nie jest w postaci kanonicznej.
+ * @param[in,out] arg : zadanie
+ * @param[in] i : numer grupy
+ */
+static void ParseSumChunk(void *arg, size_t i) {
+    ParseGroup *g = &((ParseTask *)arg)->groups[i];
+
+    if (g->sorted) {
+        g->sum = PolyOwnSortedMonos(g->size, g->monos);
+    }
+    else {
+        g->sum = PolyAddMonos(g->size, g->monos);
+        PolyMonosFree(g->monos);
     }
 }
 
+/**
+ * Konwertuje równolegle długi wielomian będący sumą jednomianów. Wiersz
+ * jest dzielony na fragmenty, w których równolegle liczona jest zmiana
+ * głębokości nawiasów, a z sum prefiksowych tych zmian wynikają znaki '+'
+ * na głębokości 0, czyli granice jednomianów najwyższego poziomu. Grupy
+ * jednomianów między takimi granicami konwertowane są równolegle, każda
+ * osobnym parserem. Wielomian jest poprawny wtedy i tylko wtedy, gdy każda
+ * grupa jest poprawną sumą jednomianów, więc wynik i wykrywane błędy są
+ * takie same jak przy konwersji sekwencyjnej. Jeśli jednomiany wszystkich
+ * grup tworzą razem postać kanoniczną, są tylko łączone, a w przeciwnym
+ * razie sumy grup są sumowane w kubełkach.
+ * @param[in] str : wiersz zaczynający się znakiem '('
+ * @param[in] length : długość wiersza
+ * @param[out] p : skonwertowany wielomian
+ * @return Czy wielomian jest poprawny?
+ */
+static bool ParsePolyParallel(const char *str, size_t length, Poly *p) {
+    size_t chunks = PoolThreads() * PARSE_PAR_CHUNKS_PER_THREAD;
+    ParseTask task = {
+        .str = str,
+        .length = length,
+        .chunks = chunks,
+        .depth = malloc(chunks * sizeof (ptrdiff_t)),
+        .plus = malloc(chunks * sizeof (size_t)),
+        .groups = malloc(chunks * sizeof (ParseGroup))
+    };
+    CHECK_PTR(task.depth);
+    CHECK_PTR(task.plus);
+    CHECK_PTR(task.groups);
+
+    PoolFor(chunks, ParseDepthChunk, &task);
+    ptrdiff_t depth = 0;
+    for (size_t i = 0; i < chunks; ++i) {
+        ptrdiff_t d = task.depth[i];
+        task.depth[i] = depth;
+        depth += d;
+    }
+    PoolFor(chunks, ParsePlusChunk, &task);
+
+    // grupa zaczyna się za pierwszym '+' najwyższego poziomu we fragmencie
+    size_t groups = 0, begin = 0;
+    for (size_t i = 1; i < chunks; ++i) {
+        if (task.plus[i] < length) {
+            task.groups[groups++] = (ParseGroup) {
+                .begin = begin, .end = task.plus[i]
+            };
+            begin = task.plus[i] + 1;
+        }
+    }
+    task.groups[groups++] = (ParseGroup) {.begin = begin, .end = length};
+
+    PoolFor(groups, ParseGroupChunk, &task);
+
+    bool ok = true;
+    for (size_t i = 0; i < groups; ++i) {
+        ok &= task.groups[i].ok;
+    }
+
+    // grupy łączą się w postać kanoniczną, gdy każda grupa jest w tej postaci
+    // i pierwszy wykładnik grupy jest większy od ostatniego w poprzedniej
+    bool sorted = ok;
+    size_t total = 0;
+    for (size_t i = 0; i < groups && sorted; ++i) {
+        ParseGroup *g = &task.groups[i];
+        sorted = g->sorted &&
+            (i == 0 || g[-1].monos[g[-1].size - 1].exp < g->monos[0].exp);
+        total += g->size;
+    }
+
+    if (!ok) {
+        for (size_t i = 0; i < groups; ++i) {
+            ParseGroup *g = &task.groups[i];
+            if (g->ok) {
+                for (size_t j = 0; j < g->size; ++j) {
+                    MonoDestroy(&g->monos[j]);
+                }
+                PolyMonosFree(g->monos);
+            }
+        }
+    }
+    else if (sorted) {
+        Mono *monos = PolyMonosNew(total);
+        total = 0;
+        for (size_t i = 0; i < groups; ++i) {
+            ParseGroup *g = &task.groups[i];
+            memcpy(monos + total, g->monos, g->size * sizeof (Mono));
+            total += g->size;
+            PolyMonosFree(g->monos);
+        }
+        *p = PolyOwnSortedMonos(total, monos);
+    }
+    else {
+        PoolFor(groups, ParseSumChunk, &task);
+        PolyBucket b = PolyBucketNew();
+        for (size_t i = 0; i < groups; ++i) {
+            PolyBucketAdd(&b, &task.groups[i].sum);
+        }
+        *p = PolyBucketSum(&b);
+    }
+
+    free(task.depth);
+    free(task.plus);
+    free(task.groups);
+    return ok;
+}
+
 /**
  * Konwertuje wiersz na obiekt typu \ref Line reprezentujący wiersz zawierający
- * wielomian.
+ * wielomian. Wiersz jest sprawdzany i konwertowany w jednym przejściu przez
+ * ParserFeed(), który dopuszcza tylko cyfry i znaki "-+(),", a każdy
+ * jednomian zamyka swój nawias, więc wiersz z niedozwolonym znakiem albo źle
+ * nawiasowany zawsze kończy się błędem konwersji.
+ * @param[in,out] parser : parser wielomianów
  * @param[in] str : wiersz
+ * @param[in] length : długość wiersza
  * @param[in] lineNr : numer linii
  * @return skonwertowany wiersz
  */
-static Line ParsePoly(const CVector *str, size_t lineNr) {
-    if (HasIllegalCharacters(str) || !AreParenthesesValid(str->items)) {
+static Line ParsePoly(Parser *parser, const char *str, size_t length,
+                      size_t lineNr) {
+    Poly p;
+
+    if (length >= PARSE_PAR_MIN_LENGTH && PoolThreads() > 1 && str[0] == '(') {
+        if (!ParsePolyParallel(str, length, &p)) {
+            PrintErrorMsg(lineNr, WRONG_POLY);
+            return WrongLine(WRONG_POLY);
+        }
+        return PolyLine(p);
+    }
+
+    ParserStart(parser);
+    if (!ParserFeed(parser, str, length) || !ParserFinish(parser, &p)) {
         PrintErrorMsg(lineNr, WRONG_POLY);
-        return WrongLine();
+        return WrongLine(WRONG_POLY);
     }
 
-    bool err = false;
-    char *end;
+    return PolyLine(p);
+}
 
-    Poly p = ParsePolyHelper(str->items, &end, &err);
+void ParsePolyStart(Parser *parser) {
+    ParserStart(parser);
+}
+
+void ParsePolyPart(Parser *parser, const char *str, size_t length) {
+    // po błędzie parser jest w stanie PARSER_ERROR i pomija resztę wiersza
+    ParserFeed(parser, str, length);
+}
 
-    if (err || *end != '\0') {
+Line ParsePolyEnd(Parser *parser, size_t lineNr) {
+    Poly p;
+    if (!ParserFinish(parser, &p)) {
         PrintErrorMsg(lineNr, WRONG_POLY);
-        PolyDestroy(&p);
-        return WrongLine();
+        return WrongLine(WRONG_POLY);
     }
-
     return PolyLine(p);
 }
 
-Line Parse(const CVector *str, size_t lineNr) {
-    if (isalpha(str->items[0])) {
-        return ParseCommand(str, lineNr);
+Line Parse(Parser *parser, const char *str, size_t length, size_t lineNr) {
+    assert(length > 0);
+
+    if (isalpha(str[0])) {
+        return ParseCommand(str, length, lineNr);
     }
     else {
-        return ParsePoly(str, lineNr);
+        return ParsePoly(parser, str, length, lineNr);
     }
-}
\ No newline at end of file
+}
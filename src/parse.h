@@ -10,24 +10,113 @@
 
 #include "line.h"
 #include "vector.h"
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
+/**
+ * To jest typ wyliczeniowy reprezentujący stan parsera wielomianu, czyli to,
+ * czego parser oczekuje w następnym znaku.
+ */
+typedef enum {
+    PARSER_POLY, ///< początku wielomianu: '(', '-' lub cyfry
+    PARSER_SIGN, ///< pierwszej cyfry współczynnika po znaku '-'
+    PARSER_COEFF, ///< kolejnej cyfry współczynnika lub znaku po nim
+    PARSER_EXP_START, ///< pierwszej cyfry wykładnika
+    PARSER_EXP, ///< kolejnej cyfry wykładnika lub ')'
+    PARSER_AFTER_MONO, ///< '+', ',' lub końca wielomianu po jednomianie
+    PARSER_MONO, ///< '(' rozpoczynającego kolejny jednomian sumy
+    PARSER_ERROR ///< niczego, wielomian jest niepoprawny
+} ParserState;
+
+/**
+ * To jest struktura otwartego poziomu zagnieżdżenia parsera, czyli sumy
+ * jednomianów, która jest w trakcie konwersji.
+ */
+typedef struct {
+    MVector monos; ///< jednomiany poziomu w tablicy z PolyMonosNew()
+    bool sorted; ///< czy wykładniki rosną ściśle i współczynniki nie są zerem
+} ParserLevel;
+
+/**
+ * To jest struktura parsera wielomianu. Parser jest automatem, który
+ * przetwarza wielomian znak po znaku bez rekurencji, więc zagnieżdżenie
+ * wielomianu nie zajmuje stosu wywołań. Jednomiany każdego otwartego poziomu
+ * zagnieżdżenia zbierane są w wektorze z puli. Wektory z puli są
+ * wykorzystywane ponownie przez kolejne poziomy i kolejne wiersze, chyba że
+ * wynik przejmie tablicę wektora.
+ */
+typedef struct {
+    ParserLevel *levels; ///< pula poziomów zagnieżdżenia
+    size_t depth; ///< liczba otwartych poziomów zagnieżdżenia
+    size_t allocated; ///< liczba wektorów w puli
+    ParserState state; ///< stan automatu
+    uint64_t value; ///< moduł wczytywanej liczby
+    bool negative; ///< czy wczytywany współczynnik jest ujemny
+    bool overflow; ///< czy wczytywana liczba przekroczyła 64 bity
+    Poly inner; ///< wielomian czekający na wykładnik swojego jednomianu
+} Parser;
+
+/**
+ * Tworzy parser z pustą pulą wektorów.
+ * @return parser
+ */
+Parser ParserNew(void);
+
+/**
+ * Zwalnia pamięć używaną przez parser.
+ * @param[in,out] self : parser
+ */
+void ParserFree(Parser *self);
+
 /**
  * Konwertuje wczytany wiersz na obiekt typu \ref Line reprezentujący ten
- * wiersz.
- * @param[in] str : wczytany wiersz
+ * wiersz. Wiersz nie musi kończyć się znakiem '\0', funkcja nie czyta
+ * znaków spoza niego.
+ * @param[in,out] parser : parser wielomianów
+ * @param[in] str : początek niepustego wiersza
+ * @param[in] length : długość wiersza
+ * @param[in] lineNr : numer wiersza
+ * @return skonwertowany wiersz
+ */
+Line Parse(Parser *parser, const char *str, size_t length, size_t lineNr);
+
+/**
+ * Rozpoczyna konwersję wielomianu podawanego we fragmentach, np. wiersza,
+ * który nie mieści się w buforze czytelnika. Parser pamięta między
+ * fragmentami tylko stan automatu i jednomiany otwartych poziomów
+ * zagnieżdżenia, więc pamięć nie zależy od długości tekstu wielomianu.
+ * @param[in,out] parser : parser wielomianów
+ */
+void ParsePolyStart(Parser *parser);
+
+/**
+ * Przetwarza kolejny fragment wielomianu rozpoczętego przez
+ * ParsePolyStart(). Fragment nie musi kończyć się na granicy liczby ani
+ * jednomianu.
+ * @param[in,out] parser : parser wielomianów
+ * @param[in] str : fragment wielomianu
+ * @param[in] length : długość fragmentu
+ */
+void ParsePolyPart(Parser *parser, const char *str, size_t length);
+
+/**
+ * Kończy konwersję wielomianu podanego we fragmentach i zwraca obiekt typu
+ * \ref Line reprezentujący wiersz z tym wielomianem. Gdy wielomian jest
+ * niepoprawny, wypisuje komunikat błędu.
+ * @param[in,out] parser : parser wielomianów
  * @param[in] lineNr : numer wiersza
  * @return skonwertowany wiersz
  */
-Line Parse(const CVector *str, size_t lineNr);
+Line ParsePolyEnd(Parser *parser, size_t lineNr);
 
 /**
  * Wypisuje komunikat błędu na standardowe wyjście błędów.
  * @param[in] lineNr : numer błędnego wiersza
  * @param[in] msg : komunikat błędu
  */
-static inline void PrintErrorMsg(size_t lineNr, char *msg) {
+static inline void PrintErrorMsg(size_t lineNr, const char *msg) {
     fprintf(stderr, "ERROR %zu %s\n", lineNr, msg);
 }
 
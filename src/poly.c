@@ -8,7 +8,12 @@
 */
 
 #include "poly.h"
+#include "coeff.h"
+#include "pool.h"
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -25,23 +30,632 @@
         }                   \
     } while (0)
 
+/// liczba głębokości, dla których przechowywany jest odcisk wielomianu
+#define FINGERPRINT_DEPTHS 4
+
+/**
+ * To jest odcisk wielomianu: jego wartości modulo @f$2^{64}@f$ dla każdej
+ * głębokości, na której może leżeć zmienna główna wielomianu. Wielomian nie
+ * wie, czy jest współczynnikiem, więc przechowuje wszystkie wartości,
+ * a wielomian przeniesiony na inną głębokość (np. przez PolyAt() lub
+ * PolyCompose()) korzysta z innej wartości bez przeliczania.
+ */
+typedef struct {
+    /// wartość, gdy pod zmienną @f$x_i@f$ wielomianu podstawiony jest punkt
+    /// głębokości @f$(d + i) \bmod@f$ #FINGERPRINT_DEPTHS
+    uint64_t at[FINGERPRINT_DEPTHS];
+} Fingerprint;
+
+/**
+ * Punkty, w których liczone są odciski wielomianów, osobne dla każdej
+ * głębokości, więc odciski wielomianów różniących się tylko nazwami
+ * zmiennych, np. @f$x_0@f$ i @f$x_1@f$, są różne. To kolejne wartości
+ * generatora splitmix64 z ziarnem 0x2021 z ustawionym najmłodszym bitem:
+ * potęgi liczb nieparzystych nie zerują się modulo @f$2^{64}@f$.
+ */
+static const Fingerprint fingerprintPoints = {{
+    0x106CEAB9A82D39D5ULL, 0xDD5A7E30C1DB2523ULL,
+    0xCD10C41C179D1A65ULL, 0x5707484E5665E559ULL
+}};
+
+/**
+ * To jest nagłówek przechowywany w pamięci bezpośrednio przed tablicą
+ * jednomianów każdego wielomianu, który nie jest współczynnikiem.
+ */
+typedef struct {
+    Fingerprint fp; ///< odcisk wielomianu
+    /// pojemność tablicy, jeśli może trafić do pamięci podręcznej tablic,
+    /// a 0 w przeciwnym razie
+    uint32_t cacheClass;
+    /// liczba odwołań do zamrożonego wielomianu albo 0, jeśli wielomian
+    /// nie jest zamrożony
+    atomic_uint refs;
+} PolyHeader;
+
+/// największa pojemność tablicy jednomianów przechowywanej w pamięci
+/// podręcznej tablic
+#define MONO_CACHE_CLASSES 8
+
+/// maksymalna liczba tablic jednej pojemności w pamięci podręcznej wątku
+#define MONO_CACHE_LIMIT 256
+
+/**
+ * To jest pamięć podręczna zwolnionych małych tablic jednomianów. Każdy
+ * wątek ma własną, więc alokacje nie wymagają synchronizacji. Tablica może
+ * zostać zwolniona przez inny wątek niż ten, który ją zaalokował; trafia
+ * wtedy do pamięci podręcznej wątku zwalniającego.
+ */
+typedef struct {
+    /// listy zwolnionych tablic według pojemności; pierwsze słowo
+    /// zwolnionej tablicy wskazuje następną
+    void *free[MONO_CACHE_CLASSES + 1];
+    unsigned count[MONO_CACHE_CLASSES + 1]; ///< długości list
+    bool registered; ///< Czy zarejestrowano zwalnianie przy końcu wątku?
+} MonoArrayCache;
+
+/// pamięć podręczna tablic bieżącego wątku
+static _Thread_local MonoArrayCache monoCache;
+
+/// klucz, którego destruktor opróżnia pamięć podręczną kończącego się wątku
+static pthread_key_t monoCacheKey;
+
+/// jednokrotne tworzenie klucza #monoCacheKey
+static pthread_once_t monoCacheKeyOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Zwalnia wszystkie tablice z pamięci podręcznej wątku.
+ * @param[in,out] arg : pamięć podręczna (MonoArrayCache)
+ */
+static void MonoArrayCacheFlush(void *arg) {
+    MonoArrayCache *cache = arg;
+    for (size_t i = 1; i <= MONO_CACHE_CLASSES; ++i) {
+        while (cache->free[i] != NULL) {
+            void *next = *(void **)cache->free[i];
+            free(cache->free[i]);
+            cache->free[i] = next;
+        }
+        cache->count[i] = 0;
+    }
+}
+
+/**
+ * Tworzy klucz #monoCacheKey.
+ */
+static void MonoArrayCacheCreateKey(void) {
+    if (pthread_key_create(&monoCacheKey, MonoArrayCacheFlush) != 0) {
+        exit(1);
+    }
+}
+
+/**
+ * Alokuje tablicę jednomianów wraz z nagłówkiem wielomianu.
+ * @param[in] size : rozmiar tablicy jednomianów
+ * @return tablica jednomianów
+ */
+static Mono *MonoArrayNew(size_t size) {
+    PolyHeader *h;
+    if (size >= 1 && size <= MONO_CACHE_CLASSES &&
+        monoCache.free[size] != NULL) {
+        h = monoCache.free[size];
+        monoCache.free[size] = *(void **)h;
+        monoCache.count[size]--;
+    }
+    else {
+        h = malloc(sizeof (PolyHeader) + size * sizeof (Mono));
+        CHECK_PTR(h);
+    }
+    h->cacheClass = size <= MONO_CACHE_CLASSES ? (uint32_t)size : 0;
+    atomic_init(&h->refs, 0);
+    return (Mono *)(h + 1);
+}
+
+/**
+ * Zmienia rozmiar tablicy jednomianów zaalokowanej przez MonoArrayNew().
+ * Nagłówek wielomianu jest zachowywany.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : nowy rozmiar tablicy
+ * @return tablica jednomianów
+ */
+static Mono *MonoArrayResize(Mono *arr, size_t size) {
+    PolyHeader *h = (PolyHeader *)arr - 1;
+    if (h->cacheClass != 0 && size <= h->cacheClass) {
+        // mała tablica się mieści, zachowujemy jej pojemność
+        return arr;
+    }
+
+    h = realloc(h, sizeof (PolyHeader) + size * sizeof (Mono));
+    CHECK_PTR(h);
+    h->cacheClass = size <= MONO_CACHE_CLASSES ? (uint32_t)size : 0;
+    return (Mono *)(h + 1);
+}
+
+/**
+ * Zwalnia tablicę jednomianów zaalokowaną przez MonoArrayNew().
+ * Nie niszczy jednomianów.
+ * @param[in] arr : tablica jednomianów
+ */
+static inline void MonoArrayFree(Mono *arr) {
+    PolyHeader *h = (PolyHeader *)arr - 1;
+    uint32_t c = h->cacheClass;
+    if (c == 0 || monoCache.count[c] >= MONO_CACHE_LIMIT) {
+        free(h);
+        return;
+    }
+
+    if (!monoCache.registered) {
+        pthread_once(&monoCacheKeyOnce, MonoArrayCacheCreateKey);
+        pthread_setspecific(monoCacheKey, &monoCache);
+        monoCache.registered = true;
+    }
+
+    *(void **)h = monoCache.free[c];
+    monoCache.free[c] = h;
+    monoCache.count[c]++;
+}
+
+/**
+ * Daje nagłówek wielomianu, który nie jest współczynnikiem.
+ * @param[in] p : wielomian
+ * @return nagłówek wielomianu
+ */
+static inline PolyHeader *PolyGetHeader(const Poly *p) {
+    assert(!PolyIsCoeff(p));
+    return (PolyHeader *)p->arr - 1;
+}
+
+/**
+ * Daje odcisk wielomianu. Odcisk współczynnika wynika z jego wartości i jest
+ * taki sam dla każdej głębokości.
+ * @param[in] p : wielomian
+ * @return odcisk wielomianu
+ */
+static inline Fingerprint PolyGetFingerprint(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        Fingerprint fp;
+        for (size_t d = 0; d < FINGERPRINT_DEPTHS; ++d) {
+            fp.at[d] = (uint64_t)p->coeff;
+        }
+        return fp;
+    }
+    return PolyGetHeader(p)->fp;
+}
+
+uint64_t PolyFingerprint(const Poly *p) {
+    return PolyGetFingerprint(p).at[0];
+}
+
+bool PolyIsFrozen(const Poly *p) {
+    return PolyIsCoeff(p) ||
+        atomic_load_explicit(&PolyGetHeader(p)->refs, memory_order_relaxed) > 0;
+}
+
+void PolyFreeze(Poly *p) {
+    if (PolyIsFrozen(p)) {
+        return;
+    }
+
+    // poddrzewo zamrożonego wielomianu też jest zamrożone
+    for (size_t i = 0; i < p->size; ++i) {
+        PolyFreeze(&p->arr[i].p);
+    }
+    atomic_store_explicit(&PolyGetHeader(p)->refs, 1, memory_order_release);
+}
+
+/**
+ * Ustawia odcisk wielomianu. Dla współczynnika nic nie robi, bo jego odcisk
+ * wynika z wartości.
+ * @param[in,out] p : wielomian
+ * @param[in] fp : odcisk
+ */
+static inline void PolySetFingerprint(Poly *p, Fingerprint fp) {
+    if (!PolyIsCoeff(p)) {
+        PolyGetHeader(p)->fp = fp;
+    }
+}
+
+/**
+ * Sprawdza równość odcisków.
+ * @param[in] a : odcisk
+ * @param[in] b : odcisk
+ * @return Czy odciski są równe na każdej głębokości?
+ */
+static inline bool FingerprintIsEq(Fingerprint a, Fingerprint b) {
+    for (size_t d = 0; d < FINGERPRINT_DEPTHS; ++d) {
+        if (a.at[d] != b.at[d]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Oblicza odcisk sumy wielomianów.
+ * @param[in] a : odcisk pierwszego składnika
+ * @param[in] b : odcisk drugiego składnika
+ * @return odcisk sumy
+ */
+static inline Fingerprint FingerprintAdd(Fingerprint a, Fingerprint b) {
+    for (size_t d = 0; d < FINGERPRINT_DEPTHS; ++d) {
+        a.at[d] += b.at[d];
+    }
+    return a;
+}
+
+/**
+ * Oblicza odcisk iloczynu wielomianów.
+ * @param[in] a : odcisk pierwszego czynnika
+ * @param[in] b : odcisk drugiego czynnika
+ * @return odcisk iloczynu
+ */
+static inline Fingerprint FingerprintMul(Fingerprint a, Fingerprint b) {
+    for (size_t d = 0; d < FINGERPRINT_DEPTHS; ++d) {
+        a.at[d] *= b.at[d];
+    }
+    return a;
+}
+
+/**
+ * Oblicza odcisk @p n-tej potęgi wielomianu, czyli @p n-te potęgi jego
+ * wartości modulo @f$2^{64}@f$.
+ * @param[in] x : odcisk podstawy
+ * @param[in] n : wykładnik
+ * @return odcisk @f$x^n@f$
+ */
+static Fingerprint FingerprintPow(Fingerprint x, poly_exp_t n) {
+    Fingerprint res;
+    for (size_t d = 0; d < FINGERPRINT_DEPTHS; ++d) {
+        res.at[d] = 1;
+    }
+    while (n) {
+        if (n % 2 == 1) {
+            res = FingerprintMul(res, x);
+        }
+        n /= 2;
+        x = FingerprintMul(x, x);
+    }
+    return res;
+}
+
+/**
+ * Oblicza odcisk jednomianu. Współczynnik jednomianu leży o jedną głębokość
+ * niżej niż jego zmienna, więc wartość dla głębokości @f$d@f$ korzysta
+ * z wartości współczynnika dla głębokości @f$d + 1@f$.
+ * @param[in] m : jednomian
+ * @return odcisk jednomianu
+ */
+static inline Fingerprint MonoFingerprint(const Mono *m) {
+    Fingerprint c = PolyGetFingerprint(&m->p);
+    Fingerprint fp = FingerprintPow(fingerprintPoints, m->exp);
+    for (size_t d = 0; d < FINGERPRINT_DEPTHS; ++d) {
+        fp.at[d] *= c.at[(d + 1) % FINGERPRINT_DEPTHS];
+    }
+    return fp;
+}
+
+/**
+ * Oblicza odcisk sumy jednomianów na podstawie odcisków ich współczynników.
+ * Jednomiany nie muszą być posortowane.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return odcisk sumy jednomianów
+ */
+static Fingerprint MonoArrayFingerprint(size_t count, const Mono *monos) {
+    Fingerprint fp = {{0}};
+    for (size_t i = 0; i < count; ++i) {
+        fp = FingerprintAdd(fp, MonoFingerprint(&monos[i]));
+    }
+    return fp;
+}
+
+/**
+ * Oblicza od nowa odcisk wielomianu. Funkcja służy wyłącznie do sprawdzania
+ * asercji, że przechowywany odcisk jest aktualny.
+ * @param[in] p : wielomian
+ * @return odcisk wielomianu
+ */
+#ifndef NDEBUG
+static Fingerprint PolyComputeFingerprint(const Poly *p) {
+    if (PolyIsCoeff(p)) {
+        return PolyGetFingerprint(p);
+    }
+    return MonoArrayFingerprint(p->size, p->arr);
+}
+#endif
+
 /**
  * Tworzy wielomian składający się z @p size jednomianów.
+ * Odcisk wielomianu musi zostać ustawiony przez wywołującego.
  * @param[in] size : rozmiar tablicy jednomianów
  * @return wielomian
  */
 static inline Poly PolyCreate(size_t size) {
-    Mono *arr = malloc((size) * sizeof (Mono));
-    CHECK_PTR(arr);
-    return (Poly) {.size = (size), .arr = arr};
+    return (Poly) {.size = (size), .arr = MonoArrayNew(size)};
+}
+
+/**
+ * Zwalnia jedno odwołanie do tablicy jednomianów wielomianu, który nie jest
+ * współczynnikiem.
+ * @param[in] p : wielomian
+ * @return Czy było to ostatnie odwołanie i tablicę trzeba usunąć?
+ */
+static inline bool PolyRelease(const Poly *p) {
+    PolyHeader *h = PolyGetHeader(p);
+    // zamrożony wielomian może mieć jeszcze inne odwołania
+    return atomic_load_explicit(&h->refs, memory_order_relaxed) == 0 ||
+        atomic_fetch_sub_explicit(&h->refs, 1, memory_order_acq_rel) == 1;
+}
+
+/// liczba ramek stosu MonoArrayDestroy() trzymanych na stosie wywołań;
+/// głębsze wielomiany wymagają stosu na stercie
+#define DESTROY_STACK_SIZE 64
+
+/**
+ * To jest ramka stosu MonoArrayDestroy(): tablica jednomianów
+ * i indeks pierwszego jednomianu, którego współczynnik nie został jeszcze
+ * usunięty.
+ */
+typedef struct DestroyFrame {
+    Mono *arr; ///< tablica jednomianów
+    size_t size; ///< rozmiar tablicy
+    size_t i; ///< indeks kolejnego jednomianu
+} DestroyFrame;
+
+/**
+ * Usuwa tablicę jednomianów, do której zwolniono już ostatnie odwołanie,
+ * razem z całym poddrzewem. Nie używa rekurencji, więc działa dla dowolnie
+ * głębokich wielomianów. Tablica jest zwalniana przed zejściem do
+ * współczynnika ostatniego jednomianu, dzięki czemu stos nie rośnie dla
+ * łańcuchów wielomianów o jednym niestałym współczynniku.
+ * @param[in] arr : tablica jednomianów
+ * @param[in] size : rozmiar tablicy
+ */
+static void MonoArrayDestroy(Mono *arr, size_t size) {
+    DestroyFrame local[DESTROY_STACK_SIZE];
+    DestroyFrame *stack = local;
+    size_t capacity = DESTROY_STACK_SIZE;
+    size_t top = 0;
+    stack[top++] = (DestroyFrame) {.arr = arr, .size = size, .i = 0};
+
+    while (top > 0) {
+        DestroyFrame *f = &stack[top - 1];
+        if (f->i == f->size) {
+            MonoArrayFree(f->arr);
+            top--;
+            continue;
+        }
+
+        Poly child = f->arr[f->i++].p;
+        if (PolyIsCoeff(&child) || !PolyRelease(&child)) {
+            continue;
+        }
+
+        if (f->i == f->size) {
+            // ostatni współczynnik zastępuje na stosie swojego rodzica
+            MonoArrayFree(f->arr);
+            top--;
+        }
+        else if (top == capacity) {
+            capacity *= 2;
+            if (stack == local) {
+                stack = malloc(capacity * sizeof (DestroyFrame));
+                CHECK_PTR(stack);
+                memcpy(stack, local, sizeof local);
+            }
+            else {
+                stack = realloc(stack, capacity * sizeof (DestroyFrame));
+                CHECK_PTR(stack);
+            }
+        }
+        stack[top++] = (DestroyFrame) {
+            .arr = child.arr, .size = child.size, .i = 0
+        };
+    }
+
+    if (stack != local) {
+        free(stack);
+    }
 }
 
 void PolyDestroy(Poly *p) {
-    if (!PolyIsCoeff(p)) {
-        for (size_t i = 0; i < p->size; ++i) {
-            MonoDestroy(&p->arr[i]);
+    if (!PolyIsCoeff(p) && PolyRelease(p)) {
+        MonoArrayDestroy(p->arr, p->size);
+    }
+}
+
+/// minimalna szacowana liczba operacji na jednomianach, od której obliczenie
+/// jest dzielone między wątki; mniejsze obliczenia, w tym na głębszych
+/// poziomach rekurencji, wykonywane są sekwencyjnie
+#define PAR_MIN_WORK ((size_t)1 << 14)
+
+/// liczba bloków jednomianów na jeden wątek w obliczeniach równoległych,
+/// większa od jedności, żeby wyrównać obciążenie wątków
+#define PAR_BLOCKS_PER_THREAD 4
+
+/**
+ * Daje liczbę jednomianów wielomianu na wszystkich poziomach, ale nie
+ * więcej niż @p limit. Każdy poziom zagnieżdżenia dolicza co najmniej jeden
+ * jednomian, więc głębokość rekurencji też jest ograniczona przez @p limit.
+ * @param[in] p : wielomian
+ * @param[in] limit : ograniczenie wyniku
+ * @return liczba jednomianów albo @p limit
+ */
+static size_t PolyTermCount(const Poly *p, size_t limit) {
+    if (PolyIsCoeff(p)) {
+        return 1;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < p->size && count < limit; ++i) {
+        const Poly *q = &p->arr[i].p;
+        count++;
+        if (!PolyIsCoeff(q) && count < limit) {
+            count += PolyTermCount(q, limit - count);
+        }
+    }
+    return count < limit ? count : limit;
+}
+
+/// minimalna liczba jednomianów na wszystkich poziomach, od której
+/// PolyDestroyDeferred() przekazuje wielomian wątkowi sprzątającemu;
+/// mniejsze wielomiany są usuwane od razu
+#define DEFER_MIN_TERMS ((size_t)1 << 12)
+
+/**
+ * To jest element kolejki wielomianów czekających na usunięcie przez wątek
+ * sprzątający.
+ */
+typedef struct DeferredPoly {
+    Mono *arr; ///< tablica jednomianów wielomianu
+    size_t size; ///< rozmiar tablicy
+    struct DeferredPoly *next; ///< następny element kolejki
+} DeferredPoly;
+
+/// muteks chroniący kolejkę wielomianów do usunięcia
+static pthread_mutex_t deferredMutex = PTHREAD_MUTEX_INITIALIZER;
+
+/// zmienna warunkowa, na której wątek sprzątający czeka na wielomiany
+static pthread_cond_t deferredReady = PTHREAD_COND_INITIALIZER;
+
+/// zmienna warunkowa, na której PolyDestroyWait() czeka na ich usunięcie
+static pthread_cond_t deferredDone = PTHREAD_COND_INITIALIZER;
+
+/// kolejka wielomianów do usunięcia
+static DeferredPoly *deferredQueue = NULL;
+
+/// liczba wielomianów przekazanych wątkowi sprzątającemu i jeszcze nieusuniętych
+static size_t deferredPending = 0;
+
+/// czy wątek sprzątający działa
+static bool reclaimerRunning = false;
+
+/// gwarantuje jednokrotne uruchomienie wątku sprzątającego
+static pthread_once_t reclaimerOnce = PTHREAD_ONCE_INIT;
+
+/**
+ * Funkcja wątku sprzątającego: usuwa wielomiany z kolejki, zdejmując
+ * za każdym razem całą kolejkę naraz.
+ * @param[in] arg : nieużywany
+ * @return nigdy nie wraca
+ */
+static void *Reclaimer(void *arg) {
+    (void)arg;
+    pthread_mutex_lock(&deferredMutex);
+    while (true) {
+        while (deferredQueue == NULL) {
+            pthread_cond_wait(&deferredReady, &deferredMutex);
+        }
+        DeferredPoly *list = deferredQueue;
+        deferredQueue = NULL;
+        pthread_mutex_unlock(&deferredMutex);
+
+        size_t count = 0;
+        while (list != NULL) {
+            DeferredPoly *next = list->next;
+            MonoArrayDestroy(list->arr, list->size);
+            free(list);
+            list = next;
+            count++;
+        }
+
+        pthread_mutex_lock(&deferredMutex);
+        deferredPending -= count;
+        if (deferredPending == 0) {
+            pthread_cond_broadcast(&deferredDone);
         }
-        free(p->arr);
+    }
+    return NULL;
+}
+
+/**
+ * Uruchamia wątek sprzątający. Jeśli się to nie uda, wielomiany są usuwane
+ * od razu.
+ */
+static void ReclaimerStart(void) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, Reclaimer, NULL) == 0) {
+        pthread_detach(thread);
+        reclaimerRunning = true;
+    }
+}
+
+void PolyDestroyDeferred(Poly *p) {
+    if (PolyIsCoeff(p) || !PolyRelease(p)) {
+        return;
+    }
+    if (PolyTermCount(p, DEFER_MIN_TERMS) < DEFER_MIN_TERMS) {
+        MonoArrayDestroy(p->arr, p->size);
+        return;
+    }
+
+    pthread_once(&reclaimerOnce, ReclaimerStart);
+    DeferredPoly *node = reclaimerRunning ? malloc(sizeof (DeferredPoly)) : NULL;
+    if (node == NULL) {
+        MonoArrayDestroy(p->arr, p->size);
+        return;
+    }
+
+    *node = (DeferredPoly) {.arr = p->arr, .size = p->size};
+    pthread_mutex_lock(&deferredMutex);
+    node->next = deferredQueue;
+    deferredQueue = node;
+    deferredPending++;
+    pthread_cond_signal(&deferredReady);
+    pthread_mutex_unlock(&deferredMutex);
+}
+
+void PolyDestroyWait(void) {
+    pthread_mutex_lock(&deferredMutex);
+    while (deferredPending > 0) {
+        pthread_cond_wait(&deferredDone, &deferredMutex);
+    }
+    pthread_mutex_unlock(&deferredMutex);
+}
+
+/**
+ * Daje liczbę bloków, na które dzielona jest tablica @p size jednomianów
+ * w obliczeniach równoległych.
+ * @param[in] size : liczba jednomianów
+ * @return liczba bloków
+ */
+static inline size_t ParBlocks(size_t size) {
+    size_t blocks = PoolThreads() * PAR_BLOCKS_PER_THREAD;
+    return blocks < size ? blocks : size;
+}
+
+/**
+ * Daje indeks pierwszego jednomianu bloku @p i przy podziale tablicy
+ * @p size jednomianów na @p blocks bloków. Podział nie zależy od tego,
+ * który wątek wykonuje który blok.
+ * @param[in] size : liczba jednomianów
+ * @param[in] blocks : liczba bloków
+ * @param[in] i : indeks bloku
+ * @return indeks pierwszego jednomianu bloku
+ */
+static inline size_t ParBlockBegin(size_t size, size_t blocks, size_t i) {
+    return size * i / blocks;
+}
+
+/**
+ * To jest struktura opisująca równoległe kopiowanie wielomianu.
+ */
+typedef struct {
+    const Poly *p; ///< kopiowany wielomian
+    Poly *res; ///< kopia
+    size_t blocks; ///< liczba bloków jednomianów
+} PolyCloneTask;
+
+/**
+ * Kopiuje @p i-ty blok jednomianów.
+ * @param[in,out] arg : opis kopiowania (PolyCloneTask)
+ * @param[in] i : indeks bloku
+ */
+static void PolyCloneBlock(void *arg, size_t i) {
+    PolyCloneTask *task = arg;
+    size_t end = ParBlockBegin(task->p->size, task->blocks, i + 1);
+
+    for (size_t j = ParBlockBegin(task->p->size, task->blocks, i); j < end;
+         ++j) {
+        task->res->arr[j] = MonoClone(&task->p->arr[j]);
     }
 }
 
@@ -49,15 +663,58 @@ Poly PolyClone(const Poly *p) {
     if (PolyIsCoeff(p)) {
         return *p;
     }
+    else if (PolyIsFrozen(p)) {
+        // zamrożony wielomian jest współdzielony, a nie kopiowany
+        atomic_fetch_add_explicit(&PolyGetHeader(p)->refs, 1,
+                                  memory_order_relaxed);
+        return *p;
+    }
     else {
         Poly newPoly = PolyCreate(p->size);
-        for (size_t i = 0; i < p->size; ++i) {
-            newPoly.arr[i] = MonoClone(&p->arr[i]);
+        if (PoolThreads() > 1 && p->size > 1 &&
+            PolyTermCount(p, PAR_MIN_WORK) >= PAR_MIN_WORK) {
+            PolyCloneTask task = {.p = p, .res = &newPoly,
+                                  .blocks = ParBlocks(p->size)};
+            PoolFor(task.blocks, PolyCloneBlock, &task);
+        }
+        else {
+            for (size_t i = 0; i < p->size; ++i) {
+                newPoly.arr[i] = MonoClone(&p->arr[i]);
+            }
         }
+        PolySetFingerprint(&newPoly, PolyGetFingerprint(p));
         return newPoly;
     }
 }
 
+/**
+ * Zapewnia, że tablicę jednomianów wielomianu można modyfikować. Jeśli
+ * wielomian jest zamrożony i ma inne odwołania, zastępuje go kopią jego
+ * tablicy jednomianów, która współdzieli zamrożone współczynniki. Jeśli to
+ * jedyne odwołanie, odmraża wielomian w miejscu. Współczynniki jednomianów
+ * pozostają zamrożone.
+ * @param[in,out] p : wielomian, do którego mamy odwołanie na własność
+ */
+static void PolyMakeMutable(Poly *p) {
+    if (PolyIsCoeff(p) || !PolyIsFrozen(p)) {
+        return;
+    }
+
+    PolyHeader *h = PolyGetHeader(p);
+    if (atomic_load_explicit(&h->refs, memory_order_acquire) == 1) {
+        atomic_store_explicit(&h->refs, 0, memory_order_relaxed);
+        return;
+    }
+
+    Poly copy = PolyCreate(p->size);
+    for (size_t i = 0; i < p->size; ++i) {
+        copy.arr[i] = MonoClone(&p->arr[i]);
+    }
+    PolySetFingerprint(&copy, h->fp);
+    PolyDestroy(p);
+    *p = copy;
+}
+
 /**
  * Sprawdza, czy tablica jednomianów jest posortowana rosnąco po wykładnikach.
  * @param[in] size : rozmiar tablicy
@@ -97,6 +754,7 @@ static bool PolyIsSorted(const Poly *p) {
 static Poly PolyFormMono(Mono m) {
     Poly p = PolyCreate(1);
     p.arr[0] = m;
+    PolySetFingerprint(&p, MonoFingerprint(&m));
     return p;
 }
 
@@ -107,8 +765,7 @@ static Poly PolyFormMono(Mono m) {
  */
 static void PolyShrinkArray(Poly *p, size_t size) {
     assert(!PolyIsCoeff(p) && size <= p->size);
-    p->arr = realloc(p->arr, size * sizeof (Mono));
-    CHECK_PTR(p->arr);
+    p->arr = MonoArrayResize(p->arr, size);
     p->size = size;
 }
 
@@ -117,12 +774,13 @@ static void PolyShrinkArray(Poly *p, size_t size) {
  * @param[in] p : wielomian
  */
 static void PolyNormalize(Poly *p) {
-    if (!PolyIsCoeff(p)) {
+    // zamrożone wielomiany są w postaci normalnej
+    if (!PolyIsFrozen(p)) {
         if (p->size == 1 && p->arr[0].exp == 0 && PolyIsCoeff(&p->arr[0].p)) {
             // wielomian p ma tylko 1 jednomian stopnia 0, którego wielomian
             // jest współczynnikiem, zatem wielomian p jest współczynnikiem
             Poly tmp = p->arr[0].p;
-            free(p->arr);
+            MonoArrayFree(p->arr);
             *p = tmp;
             return;
         }
@@ -140,14 +798,14 @@ static void PolyNormalize(Poly *p) {
         }
 
         if (nonZeroCtr == 0) {
-            free(p->arr);
+            MonoArrayFree(p->arr);
             *p = PolyZero();
             return;
         }
 
         size_t k = 0; // indeks tablicy newArr
-        Mono *newArr = malloc(nonZeroCtr * sizeof (Mono));
-        CHECK_PTR(newArr);
+        Mono *newArr = MonoArrayNew(nonZeroCtr);
+        ((PolyHeader *)newArr - 1)->fp = PolyGetFingerprint(p);
 
         for (size_t i = 0; i < p->size; ++i) {
             if (!PolyIsZero(&p->arr[i].p)) {
@@ -155,7 +813,7 @@ static void PolyNormalize(Poly *p) {
             }
         }
 
-        free(p->arr);
+        MonoArrayFree(p->arr);
         p->arr = newArr;
         p->size = nonZeroCtr;
 
@@ -163,22 +821,192 @@ static void PolyNormalize(Poly *p) {
             // wielomian p ma tylko 1 jednomian stopnia 0, którego wielomian
             // jest współczynnikiem, zatem wielomian p jest współczynnikiem
             *p = p->arr[0].p;
-            free(newArr);
+            MonoArrayFree(newArr);
         }
     }
 }
 
-Poly PolyAdd(const Poly *p, const Poly *q) {
-    assert(PolyIsSorted(p) && PolyIsSorted(q));
-
-    Poly tmp = PolyZero();
-
+/**
+ * Dodaje współczynniki jednomianów o równych wykładnikach. Liczby, czyli
+ * współczynniki w liściach, dodaje bez wywołania PolyAdd().
+ * @param[in] p : współczynnik pierwszego jednomianu
+ * @param[in] q : współczynnik drugiego jednomianu
+ * @return @f$p + q@f$
+ */
+static inline Poly PolyAddCoeffs(const Poly *p, const Poly *q) {
     if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
         return PolyFromCoeff(p->coeff + q->coeff);
     }
-    else if (PolyIsCoeff(p)) {
-        tmp = PolyFormMono(MonoFromPoly(p, 0));
-        p = &tmp;
+    return PolyAdd(p, q);
+}
+
+/**
+ * To jest punkt podziału scalania tablic jednomianów dwóch składników na
+ * bloki, które są scalane niezależnie.
+ */
+typedef struct {
+    size_t i; ///< indeks pierwszego jednomianu bloku w pierwszym składniku
+    size_t j; ///< indeks pierwszego jednomianu bloku w drugim składniku
+    size_t k; ///< indeks pierwszego jednomianu bloku w sumie
+} MergeSplit;
+
+/**
+ * To jest struktura opisująca równoległe dodawanie wielomianów.
+ */
+typedef struct {
+    const Poly *p; ///< pierwszy składnik
+    const Poly *q; ///< drugi składnik
+    Mono *arr; ///< tablica jednomianów sumy
+    MergeSplit *splits; ///< punkty podziału, o jeden więcej niż bloków
+} PolyAddTask;
+
+/**
+ * Wyznacza punkt podziału scalania tablic jednomianów wielomianów @p p
+ * i @p q na przekątnej @p d, czyli taki, że @f$i + j@f$ jest równe @p d
+ * lub @f$d + 1@f$, wszystkie jednomiany przed punktem podziału mają
+ * wykładniki mniejsze od jednomianów za nim, a jednomiany o równych
+ * wykładnikach nie są rozdzielane. Używa wyszukiwania binarnego.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] d : przekątna, @f$0 \le d \le p.size + q.size@f$
+ * @return punkt podziału, bez indeksu w sumie
+ */
+static MergeSplit MonoArrayMergeSplit(const Poly *p, const Poly *q, size_t d) {
+    size_t lo = d > q->size ? d - q->size : 0;
+    size_t hi = d < p->size ? d : p->size;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        // przy równych wykładnikach pierwszy jest jednomian p
+        if (p->arr[mid].exp <= q->arr[d - mid - 1].exp) {
+            lo = mid + 1;
+        }
+        else {
+            hi = mid;
+        }
+    }
+
+    MergeSplit split = {.i = lo, .j = d - lo};
+    if (split.i > 0 && split.j < q->size &&
+        p->arr[split.i - 1].exp == q->arr[split.j].exp) {
+        // jednomian q o tym samym wykładniku trafia do tego samego bloku
+        split.j++;
+    }
+    return split;
+}
+
+/**
+ * Liczy jednomiany sumy w @p i-tym bloku scalania.
+ * @param[in,out] arg : opis dodawania (PolyAddTask)
+ * @param[in] i : indeks bloku
+ */
+static void PolyAddCount(void *arg, size_t i) {
+    PolyAddTask *task = arg;
+    const Mono *p = task->p->arr, *q = task->q->arr;
+    size_t pi = task->splits[i].i, pEnd = task->splits[i + 1].i;
+    size_t qj = task->splits[i].j, qEnd = task->splits[i + 1].j;
+
+    size_t ties = 0;
+    while (pi < pEnd && qj < qEnd) {
+        if (p[pi].exp == q[qj].exp) {
+            ties++;
+            pi++;
+            qj++;
+        }
+        else if (p[pi].exp < q[qj].exp) {
+            pi++;
+        }
+        else {
+            qj++;
+        }
+    }
+    task->splits[i + 1].k = pEnd - task->splits[i].i +
+        qEnd - task->splits[i].j - ties;
+}
+
+/**
+ * Scala @p i-ty blok jednomianów składników w tablicę sumy, kopiując
+ * jednomiany i dodając współczynniki jednomianów o równych wykładnikach.
+ * @param[in,out] arg : opis dodawania (PolyAddTask)
+ * @param[in] i : indeks bloku
+ */
+static void PolyAddBlock(void *arg, size_t i) {
+    PolyAddTask *task = arg;
+    const Mono *p = task->p->arr, *q = task->q->arr;
+    size_t pi = task->splits[i].i, pEnd = task->splits[i + 1].i;
+    size_t qj = task->splits[i].j, qEnd = task->splits[i + 1].j;
+    Mono *res = task->arr + task->splits[i].k;
+
+    while (pi < pEnd && qj < qEnd) {
+        if (p[pi].exp == q[qj].exp) {
+            res->exp = p[pi].exp;
+            (res++)->p = PolyAddCoeffs(&p[pi++].p, &q[qj++].p);
+        }
+        else if (p[pi].exp < q[qj].exp) {
+            *res++ = MonoClone(&p[pi++]);
+        }
+        else {
+            *res++ = MonoClone(&q[qj++]);
+        }
+    }
+    while (pi < pEnd) {
+        *res++ = MonoClone(&p[pi++]);
+    }
+    while (qj < qEnd) {
+        *res++ = MonoClone(&q[qj++]);
+    }
+    assert(res == task->arr + task->splits[i + 1].k);
+}
+
+/**
+ * Dodaje tablice jednomianów dwóch wielomianów, które nie są
+ * współczynnikami, na wątkach puli. Scalanie jest dzielone na bloki
+ * o równej łącznej liczbie jednomianów składników wyszukiwaniem binarnym
+ * punktów podziału na przekątnych (merge path). Bloki najpierw równolegle
+ * liczą swoje jednomiany sumy, a po wyznaczeniu sum prefiksowych
+ * równolegle je wypełniają, dodając współczynniki rekurencyjnie, także na
+ * wątkach puli. Jednomiany sumy mogą mieć zerowe współczynniki.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[out] arr : tablica na co najmniej @f$p.size + q.size@f$ jednomianów
+ * @return liczba jednomianów sumy
+ */
+static size_t MonoArrayAddParallel(const Poly *p, const Poly *q, Mono *arr) {
+    size_t total = p->size + q->size;
+    size_t blocks = ParBlocks(total);
+    MergeSplit *splits = malloc((blocks + 1) * sizeof (MergeSplit));
+    CHECK_PTR(splits);
+
+    for (size_t b = 0; b <= blocks; ++b) {
+        splits[b] = MonoArrayMergeSplit(p, q, ParBlockBegin(total, blocks, b));
+    }
+
+    PolyAddTask task = {.p = p, .q = q, .arr = arr, .splits = splits};
+    PoolFor(blocks, PolyAddCount, &task);
+    splits[0].k = 0;
+    for (size_t b = 1; b <= blocks; ++b) {
+        splits[b].k += splits[b - 1].k;
+    }
+    PoolFor(blocks, PolyAddBlock, &task);
+
+    size_t k = splits[blocks].k;
+    free(splits);
+    return k;
+}
+
+Poly PolyAdd(const Poly *p, const Poly *q) {
+    assert(PolyIsSorted(p) && PolyIsSorted(q));
+
+    Poly tmp = PolyZero();
+    // odcisk sumy jest sumą odcisków
+    Fingerprint fp = FingerprintAdd(PolyGetFingerprint(p),
+                                    PolyGetFingerprint(q));
+
+    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+        return PolyFromCoeff(p->coeff + q->coeff);
+    }
+    else if (PolyIsCoeff(p)) {
+        tmp = PolyFormMono(MonoFromPoly(p, 0));
+        p = &tmp;
     }
     else if (PolyIsCoeff(q)) {
         tmp = PolyFormMono(MonoFromPoly(q, 0));
@@ -188,11 +1016,19 @@ Poly PolyAdd(const Poly *p, const Poly *q) {
     size_t i = 0, j = 0, k = 0;
     Poly res = PolyCreate(p->size + q->size);
 
+    if (PoolThreads() > 1 && p->size + q->size > 1 &&
+        PolyTermCount(p, PAR_MIN_WORK) + PolyTermCount(q, PAR_MIN_WORK) >=
+        PAR_MIN_WORK) {
+        k = MonoArrayAddParallel(p, q, res.arr);
+        i = p->size;
+        j = q->size;
+    }
+
     while (i < p->size && j < q->size) {
         if (p->arr[i].exp == q->arr[j].exp) {
             // wykładniki są równe, więc dodajemy
             res.arr[k].exp = p->arr[i].exp;
-            res.arr[k++].p = PolyAdd(&p->arr[i++].p, &q->arr[j++].p);
+            res.arr[k++].p = PolyAddCoeffs(&p->arr[i++].p, &q->arr[j++].p);
         }
         else if (p->arr[i].exp < q->arr[j].exp) {
             // wykładniki są różne, więc kopiujemy mniejszy jednomian,
@@ -217,6 +1053,7 @@ Poly PolyAdd(const Poly *p, const Poly *q) {
         PolyShrinkArray(&res, k);
     }
 
+    PolySetFingerprint(&res, fp);
     PolyNormalize(&res);
 
     PolyDestroy(&tmp);
@@ -224,6 +1061,143 @@ Poly PolyAdd(const Poly *p, const Poly *q) {
     return res;
 }
 
+/**
+ * Daje liczbę jednomianów wielomianu. Współczynnik jest traktowany jak
+ * wielomian z jednym jednomianem.
+ * @param[in] p : wielomian
+ * @return liczba jednomianów
+ */
+static inline size_t PolyLength(const Poly *p) {
+    return PolyIsCoeff(p) ? 1 : p->size;
+}
+
+/**
+ * Dodaje dwa wielomiany, przejmując je na własność. W odróżnieniu od
+ * PolyAdd() nie kopiuje jednomianów, tylko przenosi je do wyniku.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p + q@f$
+ */
+static Poly PolyAddOwn(Poly *p, Poly *q) {
+    if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
+        return PolyFromCoeff(p->coeff + q->coeff);
+    }
+    if (PolyIsZero(p)) {
+        return *q;
+    }
+    if (PolyIsZero(q)) {
+        return *p;
+    }
+
+    // jednomiany są przenoszone, więc nie mogą należeć do zamrożonej tablicy
+    PolyMakeMutable(p);
+    PolyMakeMutable(q);
+
+    // odcisk sumy jest sumą odcisków
+    Fingerprint fp = FingerprintAdd(PolyGetFingerprint(p),
+                                    PolyGetFingerprint(q));
+
+    // współczynnik traktujemy jak jednomian stopnia 0
+    Mono pMono = MonoFromPoly(p, 0), qMono = MonoFromPoly(q, 0);
+    Mono *pArr = PolyIsCoeff(p) ? &pMono : p->arr;
+    Mono *qArr = PolyIsCoeff(q) ? &qMono : q->arr;
+    size_t pSize = PolyLength(p), qSize = PolyLength(q);
+
+    size_t i = 0, j = 0, k = 0;
+    Poly res = PolyCreate(pSize + qSize);
+
+    while (i < pSize && j < qSize) {
+        if (pArr[i].exp == qArr[j].exp) {
+            Poly sum = PolyAddOwn(&pArr[i++].p, &qArr[j].p);
+            if (!PolyIsZero(&sum)) {
+                res.arr[k++] = MonoFromPoly(&sum, qArr[j].exp);
+            }
+            j++;
+        }
+        else if (pArr[i].exp < qArr[j].exp) {
+            res.arr[k++] = pArr[i++];
+        }
+        else {
+            res.arr[k++] = qArr[j++];
+        }
+    }
+
+    while (i < pSize) {
+        res.arr[k++] = pArr[i++];
+    }
+
+    while (j < qSize) {
+        res.arr[k++] = qArr[j++];
+    }
+
+    // jednomiany zostały przeniesione do wyniku, zwalniamy tylko tablice
+    if (!PolyIsCoeff(p)) {
+        MonoArrayFree(p->arr);
+    }
+    if (!PolyIsCoeff(q)) {
+        MonoArrayFree(q->arr);
+    }
+
+    if (k == 0) {
+        MonoArrayFree(res.arr);
+        return PolyZero();
+    }
+
+    if (k < pSize + qSize) {
+        PolyShrinkArray(&res, k);
+    }
+
+    PolySetFingerprint(&res, fp);
+    PolyNormalize(&res);
+
+    return res;
+}
+
+/**
+ * Daje maksymalną liczbę jednomianów wielomianu w kubełku o indeksie @p i.
+ * @param[in] i : indeks kubełka
+ * @return pojemność kubełka
+ */
+static inline size_t PolyBucketCapacity(size_t i) {
+    return (size_t)4 << (2 * i);
+}
+
+PolyBucket PolyBucketNew(void) {
+    PolyBucket b;
+    for (size_t i = 0; i < POLY_BUCKETS; ++i) {
+        b.buckets[i] = PolyZero();
+    }
+    return b;
+}
+
+void PolyBucketAdd(PolyBucket *b, Poly *p) {
+    size_t i = 0;
+    while (i + 1 < POLY_BUCKETS && PolyLength(p) > PolyBucketCapacity(i)) {
+        i++;
+    }
+
+    Poly sum = PolyAddOwn(&b->buckets[i], p);
+    b->buckets[i] = PolyZero();
+
+    // jeśli suma nie mieści się w kubełku, przenosimy ją do kolejnego
+    while (i + 1 < POLY_BUCKETS && PolyLength(&sum) > PolyBucketCapacity(i)) {
+        i++;
+        sum = PolyAddOwn(&b->buckets[i], &sum);
+        b->buckets[i] = PolyZero();
+    }
+
+    b->buckets[i] = sum;
+}
+
+Poly PolyBucketSum(PolyBucket *b) {
+    Poly res = PolyZero();
+    for (size_t i = 0; i < POLY_BUCKETS; ++i) {
+        res = PolyAddOwn(&res, &b->buckets[i]);
+        b->buckets[i] = PolyZero();
+    }
+    return res;
+}
+
 /**
  * Porównuje dwa jednomiany po wykładniku.
  * @param[in] a : wielomian @f$a@f$
@@ -241,127 +1215,858 @@ static int MonoCompare(const void* a, const void* b) {
     return 0;
 }
 
+/**
+ * Najmniejsza długość ciągu jednomianów o równych wykładnikach, od której
+ * MonoArrayFold() sumuje je w kubełkach zamiast kolejno.
+ */
+#define MIN_BUCKET_RUN 8
+
+/**
+ * Sortuje tablicę jednomianów po wykładnikach, sumuje jednomiany o równych
+ * wykładnikach i usuwa jednomiany o zerowym współczynniku. Wynik zostaje
+ * w początkowym fragmencie tablicy. Długie ciągi jednomianów o równych
+ * wykładnikach sumowane są w kubełkach geometrycznych.
+ * @param[in,out] monos : tablica jednomianów
+ * @param[in] count : liczba jednomianów
+ * @return liczba jednomianów po scaleniu
+ */
+static size_t MonoArrayFold(Mono *monos, size_t count) {
+    if (!MonoIsArraySorted(count, monos)) {
+        qsort(monos, count, sizeof (Mono), MonoCompare);
+    }
+
+    size_t k = 0;
+
+    for (size_t i = 0; i < count;) {
+        size_t end = i + 1;
+        while (end < count && monos[end].exp == monos[i].exp) {
+            end++;
+        }
+
+        Mono m = monos[i];
+        if (end - i <= MIN_BUCKET_RUN) {
+            for (size_t j = i + 1; j < end; ++j) {
+                m.p = PolyAddOwn(&m.p, &monos[j].p);
+            }
+        }
+        else {
+            PolyBucket b = PolyBucketNew();
+            for (size_t j = i; j < end; ++j) {
+                PolyBucketAdd(&b, &monos[j].p);
+            }
+            m.p = PolyBucketSum(&b);
+        }
+
+        if (!PolyIsZero(&m.p)) {
+            monos[k++] = m;
+        }
+        i = end;
+    }
+
+    return k;
+}
+
+/**
+ * Sumuje listę jednomianów i tworzy z nich wielomian o znanym odcisku.
+ * Działa jak PolyOwnMonos(), ale nie liczy odcisku wyniku, tylko przyjmuje go
+ * od wywołującego.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @param[in] fp : odcisk sumy jednomianów
+ * @return wielomian będący sumą jednomianów
+ */
+static Poly PolyOwnMonosWithFingerprint(size_t count, Mono *monos,
+                                        Fingerprint fp) {
+    size_t k = MonoArrayFold(monos, count);
+
+    if (k == 0) {
+        free(monos);
+        return PolyZero();
+    }
+
+    Poly res = PolyCreate(k);
+    memcpy(res.arr, monos, k * sizeof (Mono));
+    free(monos);
+
+    PolySetFingerprint(&res, fp);
+    PolyNormalize(&res);
+
+    return res;
+}
+
 Poly PolyOwnMonos(size_t count, Mono *monos) {
     if (count == 0 || monos == NULL) {
         return PolyZero();
     }
-    if (count == 1) {
-        if (PolyIsZero(&monos[0].p)) {
-            free(monos);
-            return PolyZero();
+    return PolyOwnMonosWithFingerprint(count, monos,
+                                       MonoArrayFingerprint(count, monos));
+}
+
+Mono *PolyMonosNew(size_t count) {
+    return MonoArrayNew(count);
+}
+
+Mono *PolyMonosResize(Mono *monos, size_t count) {
+    return MonoArrayResize(monos, count);
+}
+
+void PolyMonosFree(Mono *monos) {
+    MonoArrayFree(monos);
+}
+
+/**
+ * Sprawdza, czy jednomiany są w postaci kanonicznej wymaganej przez
+ * PolyOwnSortedMonos(). Służy do asercji.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów
+ * @return Czy wykładniki rosną ściśle i żaden współczynnik nie jest zerem?
+ */
+static inline bool MonoArrayIsSorted(size_t count, const Mono *monos) {
+    for (size_t i = 0; i < count; ++i) {
+        if (PolyIsZero(&monos[i].p) ||
+            (i > 0 && monos[i - 1].exp >= monos[i].exp)) {
+            return false;
         }
-        Poly p = PolyFormMono(monos[0]);
-        PolyNormalize(&p);
-        free(monos);
+    }
+    return true;
+}
+
+Poly PolyOwnSortedMonos(size_t count, Mono *monos) {
+    assert(MonoArrayIsSorted(count, monos));
+
+    if (count == 0) {
+        MonoArrayFree(monos);
+        return PolyZero();
+    }
+
+    if (count == 1 && monos[0].exp == 0 && PolyIsCoeff(&monos[0].p)) {
+        // jedyny jednomian stopnia 0 ze współczynnikiem jest współczynnikiem
+        Poly p = monos[0].p;
+        MonoArrayFree(monos);
         return p;
     }
 
-    if (!MonoIsArraySorted(count, monos)) {
-        qsort(monos, count, sizeof (Mono), MonoCompare);
+    Poly res = {.size = count, .arr = MonoArrayResize(monos, count)};
+    PolySetFingerprint(&res, MonoArrayFingerprint(count, res.arr));
+
+    return res;
+}
+
+Poly PolyAddMonos(size_t count, const Mono monos[]) {
+    if (count == 0 || monos == NULL) {
+        return PolyZero();
     }
 
-    Poly res = PolyCreate(count);
+    Mono *monosArr = malloc(count * sizeof (Mono));
+    CHECK_PTR(monosArr);
+    memcpy(monosArr, monos, count * sizeof (Mono));
 
-    size_t k = 0;
+    return PolyOwnMonos(count, monosArr);
+}
+
+Poly PolyCloneMonos(size_t count, const Mono monos[]) {
+    if (count == 0 || monos == NULL) {
+        return PolyZero();
+    }
+
+    Mono *monosArr = malloc(count * sizeof (Mono));
+    CHECK_PTR(monosArr);
+
+    for (size_t i = 0; i < count; ++i) {
+        monosArr[i] = MonoClone(&monos[i]);
+    }
+
+    return PolyOwnMonos(count, monosArr);
+}
+
+/**
+ * Mnoży wielomian przez współczynnik.
+ * Mnnożony wielomian jest modyfikowany.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] c : współczynnik @f$c@f$
+ */
+static void PolyMulByCoeff(Poly *p, poly_coeff_t c);
 
-    res.arr[k++] = monos[0];
+/**
+ * Mnoży jednomian przez współczynnik.
+ * Mnnożony jednomian jest modyfikowany. Jest to funkcja pomocnicza dla
+ * PolyMulByCoeff() i nie jest wywoływana w żadnym innym miejscu.
+ * @param[in] m : jednomian @f$m@f$
+ * @param[in] c : współczynnik @f$c@f$
+ */
+static inline void MonoMulByCoeff(Mono *m, poly_coeff_t c) {
+    assert(c != 0);
+    PolyMulByCoeff(&m->p, c);
+}
 
-    for (size_t i = 1; i < count; ++i) {
-        if (monos[i].exp == res.arr[k - 1].exp) {
-            Poly sum = PolyAdd(&res.arr[k - 1].p, &monos[i].p);
-            MonoDestroy(&res.arr[k - 1]);
-            MonoDestroy(&monos[i]);
-            res.arr[k - 1].p = sum;
+static void PolyMulByCoeff(Poly *p, poly_coeff_t c) {
+    if (c == 0) {
+        PolyDestroy(p);
+        *p = PolyZero();
+    }
+    else if (c == 1) {
+        return;
+    }
+    else if (PolyIsCoeff(p)) {
+        p->coeff *= c;
+    }
+    else {
+        PolyMakeMutable(p);
+        for (size_t i = 0; i < p->size; ++i) {
+            // współczynniki w liściach mnożymy bez wywołania rekurencyjnego
+            if (PolyIsCoeff(&p->arr[i].p)) {
+                p->arr[i].p.coeff *= c;
+            }
+            else {
+                MonoMulByCoeff(&p->arr[i], c);
+            }
+        }
+        // odcisk iloczynu jest iloczynem odcisków
+        Fingerprint *fp = &PolyGetHeader(p)->fp;
+        for (size_t d = 0; d < FINGERPRINT_DEPTHS; ++d) {
+            fp->at[d] *= (uint64_t)c;
+        }
+    }
+}
+
+/**
+ * Mnoży dwa jednomiany.
+ * @param[in] m : jednomian @f$m@f$
+ * @param[in] n : jednomian @f$n@f$
+ * @return @f$m * n@f$
+ */
+static inline Mono MonoMul(const Mono *m, const Mono *n) {
+    return (Mono) {.p = PolyMul(&m->p, &n->p), .exp = m->exp + n->exp};
+}
+
+/**
+ * Dołącza posortowaną tablicę jednomianów do posortowanego wyniku
+ * częściowego. Scalanie odbywa się od końca w miejscu, w tablicy wyniku
+ * powiększonej o rozmiar dołączanej tablicy, więc poza nią nie jest
+ * potrzebna żadna dodatkowa pamięć. Jednomiany o zerowym współczynniku są
+ * usuwane. Przejmuje na własność zawartość tablicy @p monos.
+ * @param[in,out] acc : wynik częściowy
+ * @param[in] monos : tablica jednomianów bez powtórzeń wykładników
+ * @param[in] count : liczba jednomianów
+ */
+static void PolyMergeMonos(Poly *acc, Mono *monos, size_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    size_t i = acc->size, j = count, k = acc->size + count;
+    acc->arr = acc->arr == NULL ? MonoArrayNew(k) : MonoArrayResize(acc->arr, k);
+
+    while (j > 0) {
+        if (i > 0 && acc->arr[i - 1].exp > monos[j - 1].exp) {
+            acc->arr[--k] = acc->arr[--i];
+        }
+        else if (i > 0 && acc->arr[i - 1].exp == monos[j - 1].exp) {
+            --i;
+            --j;
+            Mono sum = {.p = PolyAddOwn(&acc->arr[i].p, &monos[j].p),
+                        .exp = monos[j].exp};
+            if (!PolyIsZero(&sum.p)) {
+                acc->arr[--k] = sum;
+            }
         }
         else {
-            res.arr[k++] = monos[i];
+            acc->arr[--k] = monos[--j];
+        }
+    }
+
+    // jednomiany acc->arr[0..i) są na swoich miejscach, a scalone jednomiany
+    // zajmują acc->arr[k..); przesuwamy je, jeśli powstała między nimi luka
+    size_t merged = acc->size + count - k;
+    if (k > i) {
+        memmove(acc->arr + i, acc->arr + k, merged * sizeof (Mono));
+    }
+    acc->size = i + merged;
+}
+
+/// domyślny limit pamięci roboczej mnożenia w bajtach
+#define DEFAULT_MUL_WORKING_SET ((size_t)1 << 22)
+
+/**
+ * Liczba jednomianów iloczynu, które PolyMul() wylicza, zanim scali je
+ * z wynikiem częściowym. Ustawienie jest wspólne dla wszystkich wątków,
+ * dlatego jest atomowe.
+ */
+static atomic_size_t mulChunkSize = DEFAULT_MUL_WORKING_SET / sizeof (Mono);
+
+void PolySetMulWorkingSet(size_t bytes) {
+    atomic_store_explicit(&mulChunkSize,
+                          bytes < sizeof (Mono) ? 1 : bytes / sizeof (Mono),
+                          memory_order_relaxed);
+}
+
+/**
+ * Scala dwa sąsiednie posortowane ciągi jednomianów bez powtórzeń
+ * wykładników: @p arr[0..la) i @p arr[la..la+lb). Jednomiany o równych
+ * wykładnikach są sumowane, a zerowe usuwane. Wynik zostaje w początkowym
+ * fragmencie @p arr.
+ * @param[in,out] arr : tablica jednomianów
+ * @param[in] la : długość pierwszego ciągu
+ * @param[in] lb : długość drugiego ciągu
+ * @param[in] tmp : bufor pomocniczy na co najmniej @p la jednomianów
+ * @return długość scalonego ciągu
+ */
+static size_t MonoRunsMerge(Mono *arr, size_t la, size_t lb, Mono *tmp) {
+    memcpy(tmp, arr, la * sizeof (Mono));
+
+    // k < j dopóki i < la, więc nie nadpisujemy nieprzeczytanych jednomianów
+    size_t i = 0, j = la, k = 0, end = la + lb;
+
+    while (i < la && j < end) {
+        if (tmp[i].exp < arr[j].exp) {
+            arr[k++] = tmp[i++];
+        }
+        else if (tmp[i].exp > arr[j].exp) {
+            arr[k++] = arr[j++];
+        }
+        else {
+            poly_exp_t exp = arr[j].exp;
+            Poly sum = PolyAddOwn(&tmp[i++].p, &arr[j++].p);
+            if (!PolyIsZero(&sum)) {
+                arr[k++] = MonoFromPoly(&sum, exp);
+            }
+        }
+    }
+
+    while (i < la) {
+        arr[k++] = tmp[i++];
+    }
+
+    while (j < end) {
+        arr[k++] = arr[j++];
+    }
+
+    return k;
+}
+
+/**
+ * Scala ostatnie posortowane ciągi na stosie ciągów leżących kolejno
+ * w @p arr. Dla @p ratio równego 0 scala wszystkie ciągi w jeden, a w
+ * przeciwnym razie scala, dopóki przedostatni ciąg nie jest dłuższy niż
+ * @p ratio razy ostatni.
+ * @param[in,out] arr : tablica jednomianów
+ * @param[in,out] runs : długości kolejnych ciągów
+ * @param[in,out] runCount : liczba ciągów
+ * @param[in] ratio : wymagany stosunek długości sąsiednich ciągów
+ * @param[in] tmp : bufor pomocniczy
+ * @return łączna długość ciągów
+ */
+static size_t MonoRunsCollapse(Mono *arr, size_t *runs, size_t *runCount,
+                               size_t ratio, Mono *tmp) {
+    size_t used = 0;
+    for (size_t i = 0; i < *runCount; ++i) {
+        used += runs[i];
+    }
+
+    while (*runCount > 1 &&
+           (ratio == 0 || runs[*runCount - 2] <= ratio * runs[*runCount - 1])) {
+        size_t la = runs[*runCount - 2], lb = runs[*runCount - 1];
+        Mono *start = arr + used - la - lb;
+        runs[*runCount - 2] = MonoRunsMerge(start, la, lb, tmp);
+        used = start - arr + runs[*runCount - 2];
+        (*runCount)--;
+    }
+
+    return used;
+}
+
+/**
+ * Liczba wierszy (jednomianów @p p) i kolumn (jednomianów @p q) kafelka
+ * iloczynów w PolyMulMerge(). Jednomiany kafelka mieszczą się w pamięci L1,
+ * a jego iloczyny w pamięci L2.
+ */
+#define MUL_TILE 64
+
+/**
+ * Maksymalna liczba posortowanych ciągów w porcji iloczynów. Długości
+ * kolejnych ciągów na stosie maleją co najmniej dwukrotnie, więc tyle
+ * wystarcza dla każdej porcji.
+ */
+#define MUL_MAX_RUNS 64
+
+/**
+ * Mnoży dwa wielomiany, które nie są współczynnikami, scalając posortowane
+ * porcje iloczynów jednomianów.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$ bez odcisku, przed normalizacją
+ */
+static Poly PolyMulMerge(const Poly *p, const Poly *q) {
+    // Iloczyny jednomianów liczymy porcjami i scalamy każdą porcję z wynikiem
+    // częściowym, zanim policzymy następną, więc nigdy nie trzymamy w pamięci
+    // wszystkich p->size * q->size iloczynów naraz. Porcja rośnie razem
+    // z wynikiem częściowym, dzięki czemu łączny koszt scalania jest liniowy
+    // względem liczby iloczynów. Limit pamięci roboczej dzielimy po równo
+    // między porcję i bufor pomocniczy do scalania.
+    //
+    // Porcję wypełniamy kafelkami: blokami MUL_TILE jednomianów p razy
+    // MUL_TILE jednomianów q. Kafelek sortujemy i sumujemy, gdy jest jeszcze
+    // w pamięci podręcznej, a powstałe posortowane ciągi scalamy sekwencyjnie
+    // jak w sortowaniu przez scalanie, zamiast sortować całą porcję naraz.
+    size_t total = p->size > SIZE_MAX / q->size ? SIZE_MAX : p->size * q->size;
+    size_t half = atomic_load_explicit(&mulChunkSize, memory_order_relaxed) / 2;
+    size_t chunkSize = half < total ? half : total;
+    chunkSize = chunkSize == 0 ? 1 : chunkSize;
+
+    size_t tileCols = q->size < MUL_TILE ? q->size : MUL_TILE;
+    tileCols = tileCols < chunkSize ? tileCols : chunkSize;
+    size_t tileRows = p->size < MUL_TILE ? p->size : MUL_TILE;
+    tileRows = tileRows * tileCols <= chunkSize ? tileRows : chunkSize / tileCols;
+
+    Mono *chunk = malloc(chunkSize * sizeof (Mono));
+    Mono *tmp = malloc(chunkSize * sizeof (Mono));
+    CHECK_PTR(chunk);
+    CHECK_PTR(tmp);
+
+    Poly res = {.size = 0, .arr = NULL};
+    size_t runs[MUL_MAX_RUNS];
+    size_t runCount = 0, used = 0;
+
+    for (size_t i0 = 0; i0 < p->size; i0 += tileRows) {
+        size_t i1 = i0 + tileRows < p->size ? i0 + tileRows : p->size;
+
+        for (size_t j0 = 0; j0 < q->size; j0 += tileCols) {
+            size_t j1 = j0 + tileCols < q->size ? j0 + tileCols : q->size;
+
+            if (used + (i1 - i0) * (j1 - j0) > chunkSize) {
+                // porcja jest pełna, scalamy jej ciągi i dołączamy do wyniku
+                used = MonoRunsCollapse(chunk, runs, &runCount, 0, tmp);
+                PolyMergeMonos(&res, chunk, used);
+                runCount = used = 0;
+
+                if (res.size > chunkSize && chunkSize < total) {
+                    chunkSize = res.size < total ? res.size : total;
+                    chunk = realloc(chunk, chunkSize * sizeof (Mono));
+                    tmp = realloc(tmp, chunkSize * sizeof (Mono));
+                    CHECK_PTR(chunk);
+                    CHECK_PTR(tmp);
+                }
+            }
+
+            Mono *tile = chunk + used;
+            size_t k = 0;
+            for (size_t i = i0; i < i1; ++i) {
+                for (size_t j = j0; j < j1; ++j) {
+                    tile[k++] = MonoMul(&p->arr[i], &q->arr[j]);
+                }
+            }
+
+            runs[runCount++] = MonoArrayFold(tile, k);
+            used += runs[runCount - 1];
+
+            used = MonoRunsCollapse(chunk, runs, &runCount, 2, tmp);
+        }
+    }
+
+    used = MonoRunsCollapse(chunk, runs, &runCount, 0, tmp);
+    PolyMergeMonos(&res, chunk, used);
+
+    free(chunk);
+    free(tmp);
+
+    if (res.size == 0) {
+        if (res.arr != NULL) {
+            MonoArrayFree(res.arr);
+        }
+        return PolyZero();
+    }
+
+    return res;
+}
+
+/**
+ * To jest tablica z haszowaniem otwartym (adresowanie liniowe), w której
+ * PolyMulHash() sumuje iloczyny jednomianów o równych wykładnikach. Wolne
+ * miejsca mają wykładnik -1.
+ */
+typedef struct {
+    Mono *slots; ///< tablica miejsc
+    size_t capacity; ///< liczba miejsc, potęga dwójki
+    size_t size; ///< liczba zajętych miejsc
+} MonoHashTable;
+
+/**
+ * Tworzy pustą tablicę z haszowaniem.
+ * @param[in] capacity : liczba miejsc, potęga dwójki
+ * @return tablica z haszowaniem
+ */
+static MonoHashTable MonoHashTableNew(size_t capacity) {
+    MonoHashTable t = {.slots = malloc(capacity * sizeof (Mono)),
+                       .capacity = capacity, .size = 0};
+    CHECK_PTR(t.slots);
+    for (size_t i = 0; i < capacity; ++i) {
+        t.slots[i].exp = -1;
+    }
+    return t;
+}
+
+/**
+ * Wyznacza miejsce, od którego szukamy jednomianu o wykładniku @p exp
+ * (haszowanie Fibonacciego).
+ * @param[in] t : tablica z haszowaniem
+ * @param[in] exp : wykładnik
+ * @return indeks miejsca
+ */
+static inline size_t MonoHashTableSlot(const MonoHashTable *t, poly_exp_t exp) {
+    return (size_t)(((uint64_t)exp * 0x9E3779B97F4A7C15ULL) >> 32) &
+        (t->capacity - 1);
+}
+
+static void MonoHashTableInsert(MonoHashTable *t, Mono m);
+
+/**
+ * Podwaja liczbę miejsc tablicy z haszowaniem.
+ * @param[in,out] t : tablica z haszowaniem
+ */
+static void MonoHashTableGrow(MonoHashTable *t) {
+    MonoHashTable bigger = MonoHashTableNew(2 * t->capacity);
+    for (size_t i = 0; i < t->capacity; ++i) {
+        if (t->slots[i].exp != -1) {
+            MonoHashTableInsert(&bigger, t->slots[i]);
+        }
+    }
+    free(t->slots);
+    *t = bigger;
+}
+
+/**
+ * Dodaje jednomian do tablicy z haszowaniem. Jeśli w tablicy jest już
+ * jednomian o tym samym wykładniku, to współczynniki są sumowane.
+ * Przejmuje na własność jednomian @p m.
+ * @param[in,out] t : tablica z haszowaniem
+ * @param[in] m : jednomian
+ */
+static void MonoHashTableInsert(MonoHashTable *t, Mono m) {
+    size_t i = MonoHashTableSlot(t, m.exp);
+    while (t->slots[i].exp != -1 && t->slots[i].exp != m.exp) {
+        i = (i + 1) & (t->capacity - 1);
+    }
+
+    if (t->slots[i].exp == m.exp) {
+        t->slots[i].p = PolyAddOwn(&t->slots[i].p, &m.p);
+        return;
+    }
+
+    t->slots[i] = m;
+    // utrzymujemy wypełnienie tablicy poniżej 1/2
+    if (2 * ++t->size > t->capacity) {
+        MonoHashTableGrow(t);
+    }
+}
+
+/// maksymalna początkowa liczba miejsc tablicy z haszowaniem
+#define MUL_HASH_MAX_INITIAL ((size_t)1 << 20)
+
+/**
+ * Mnoży dwa wielomiany, które nie są współczynnikami, sumując iloczyny
+ * jednomianów w tablicy z haszowaniem po wykładniku. Różne wykładniki
+ * sortowane są tylko raz, na końcu. Pamięć robocza jest proporcjonalna do
+ * rozmiaru wyniku, a nie do liczby iloczynów.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$ bez odcisku, przed normalizacją
+ */
+static Poly PolyMulHash(const Poly *p, const Poly *q) {
+    // wynik ma co najwyżej tyle jednomianów, ile jest możliwych wykładników
+    // i ile jest iloczynów
+    uint64_t spread = (uint64_t)(p->arr[p->size - 1].exp - p->arr[0].exp) +
+        (uint64_t)(q->arr[q->size - 1].exp - q->arr[0].exp) + 1;
+    uint64_t bound = (uint64_t)p->size * q->size;
+    bound = spread < bound ? spread : bound;
+
+    size_t capacity = 16;
+    while (capacity < 2 * bound && capacity < MUL_HASH_MAX_INITIAL) {
+        capacity *= 2;
+    }
+    MonoHashTable t = MonoHashTableNew(capacity);
+
+    for (size_t i = 0; i < p->size; ++i) {
+        for (size_t j = 0; j < q->size; ++j) {
+            MonoHashTableInsert(&t, MonoMul(&p->arr[i], &q->arr[j]));
+        }
+    }
+
+    // przenosimy niezerowe jednomiany na początek tablicy miejsc
+    size_t k = 0;
+    for (size_t i = 0; i < t.capacity; ++i) {
+        if (t.slots[i].exp != -1) {
+            if (PolyIsZero(&t.slots[i].p)) {
+                continue;
+            }
+            t.slots[k++] = t.slots[i];
+        }
+    }
+
+    if (k == 0) {
+        free(t.slots);
+        return PolyZero();
+    }
+
+    qsort(t.slots, k, sizeof (Mono), MonoCompare);
+
+    Poly res = PolyCreate(k);
+    memcpy(res.arr, t.slots, k * sizeof (Mono));
+    free(t.slots);
+
+    return res;
+}
+
+/// strategia mnożenia wybrana przez PolySetMulStrategy(), wspólna dla
+/// wszystkich wątków, dlatego atomowa
+static atomic_int mulStrategy = POLY_MUL_AUTO;
+
+void PolySetMulStrategy(PolyMulStrategy strategy) {
+    atomic_store_explicit(&mulStrategy, strategy, memory_order_relaxed);
+}
+
+/**
+ * Sprawdza, czy iloczyny jednomianów wielomianów @p p i @p q często mają
+ * równe wykładniki. Zakładamy, że tak jest, gdy przedział możliwych
+ * wykładników iloczynu nie jest większy od liczby iloczynów. Wtedy tablica
+ * z haszowaniem pozostaje mała, a sortowane są tylko różne wykładniki.
+ * Przy rozproszonych wykładnikach tablica rośnie do rozmiaru wszystkich
+ * iloczynów i scalanie posortowanych porcji jest szybsze.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return Czy iloczyny często mają równe wykładniki?
+ */
+static bool PolyMulCollapses(const Poly *p, const Poly *q) {
+    uint64_t spread = (uint64_t)(p->arr[p->size - 1].exp - p->arr[0].exp) +
+        (uint64_t)(q->arr[q->size - 1].exp - q->arr[0].exp) + 1;
+    return spread <= (uint64_t)p->size * q->size;
+}
+
+/// największy stosunek przedziału wykładników wielomianu do liczby jego
+/// jednomianów, przy którym PolyMulDense() uznaje wielomian za gęsty
+#define DENSE_MAX_SPREAD 2
+
+/**
+ * Sprawdza, czy wszystkie jednomiany wielomianu, który nie jest
+ * współczynnikiem, mają współczynniki będące liczbami.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest liściem drzewa wielomianu?
+ */
+static bool PolyIsLeaf(const Poly *p) {
+    for (size_t i = 0; i < p->size; ++i) {
+        if (!PolyIsCoeff(&p->arr[i].p)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Sprawdza, czy PolyMulDense() może pomnożyć wielomian @p p przez gęsty
+ * wielomian @p q: przedział wykładników @p q jest co najwyżej
+ * #DENSE_MAX_SPREAD razy większy od liczby jego jednomianów, a przedział
+ * wykładników iloczynu nie jest większy od liczby iloczynów jednomianów.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return Czy wielomiany nadają się do mnożenia splotem?
+ */
+static bool PolyMulDenseFits(const Poly *p, const Poly *q) {
+    uint64_t pSpread = (uint64_t)(p->arr[p->size - 1].exp - p->arr[0].exp);
+    uint64_t qSpread = (uint64_t)(q->arr[q->size - 1].exp - q->arr[0].exp);
+    return qSpread < (uint64_t)DENSE_MAX_SPREAD * q->size &&
+        pSpread + qSpread + 1 <= (uint64_t)p->size * q->size;
+}
+
+/**
+ * Mnoży wielomiany @p p i @p q, które nie są współczynnikami, jeśli oba są
+ * liśćmi i któryś z nich jest gęsty (zob. PolyMulDenseFits()). Współczynniki
+ * gęstego czynnika pakowane są do tablicy indeksowanej wykładnikiem,
+ * a iloczyn liczony jest w takiej samej tablicy, do której każdy jednomian
+ * drugiego czynnika dodaje spakowany gęsty czynnik pomnożony przez swój
+ * współczynnik. Dodawanie wykonuje wektorowe jądro CoeffAxpy(). Wynik ma
+ * tylko niezerowe jednomiany, ale nie ma ustawionego odcisku.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[out] res : @f$p * q@f$
+ * @return Czy wielomiany zostały pomnożone?
+ */
+static bool PolyMulDense(const Poly *p, const Poly *q, Poly *res) {
+    if (!PolyIsLeaf(p) || !PolyIsLeaf(q)) {
+        return false;
+    }
+    if (!PolyMulDenseFits(p, q)) {
+        if (!PolyMulDenseFits(q, p)) {
+            return false;
+        }
+        const Poly *tmp = p;
+        p = q;
+        q = tmp;
+    }
+
+    poly_exp_t pFirst = p->arr[0].exp, qFirst = q->arr[0].exp;
+    size_t qSpan = (size_t)(q->arr[q->size - 1].exp - qFirst) + 1;
+    size_t span = (size_t)(p->arr[p->size - 1].exp - pFirst) + qSpan;
+    poly_coeff_t *packed = calloc(qSpan + span, sizeof (poly_coeff_t));
+    CHECK_PTR(packed);
+    poly_coeff_t *dense = packed + qSpan;
+
+    for (size_t j = 0; j < q->size; ++j) {
+        packed[q->arr[j].exp - qFirst] = q->arr[j].p.coeff;
+    }
+    for (size_t i = 0; i < p->size; ++i) {
+        CoeffAxpy(dense + (p->arr[i].exp - pFirst), packed, qSpan,
+                  p->arr[i].p.coeff);
+    }
+
+    size_t count = 0;
+    for (size_t k = 0; k < span; ++k) {
+        count += dense[k] != 0;
+    }
+    if (count == 0) {
+        *res = PolyZero();
+    }
+    else {
+        *res = PolyCreate(count);
+        count = 0;
+        for (size_t k = 0; k < span; ++k) {
+            if (dense[k] != 0) {
+                res->arr[count++] = (Mono) {
+                    .p = PolyFromCoeff(dense[k]),
+                    .exp = pFirst + qFirst + (poly_exp_t)k
+                };
+            }
         }
     }
+    free(packed);
+    return true;
+}
 
-    if (k < count) {
-        PolyShrinkArray(&res, k);
+/**
+ * Mnoży dwa wielomiany, które nie są współczynnikami, sposobem wybranym
+ * przez PolySetMulStrategy(). Wielomian @p p może być fragmentem tablicy
+ * jednomianów innego wielomianu, dlatego jego odcisk podawany jest osobno.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @param[in] pFingerprint : odcisk wielomianu @f$p@f$
+ * @return @f$p * q@f$
+ */
+static Poly PolyMulSequential(const Poly *p, const Poly *q,
+                              Fingerprint pFingerprint) {
+    Poly res;
+    switch (atomic_load_explicit(&mulStrategy, memory_order_relaxed)) {
+        case POLY_MUL_MERGE:
+            res = PolyMulMerge(p, q);
+            break;
+        case POLY_MUL_HASH:
+            res = PolyMulHash(p, q);
+            break;
+        default:
+            if (!PolyMulDense(p, q, &res)) {
+                res = PolyMulCollapses(p, q) ? PolyMulHash(p, q)
+                                             : PolyMulMerge(p, q);
+            }
     }
 
-    PolyNormalize(&res);
-
-    free(monos);
+    if (!PolyIsCoeff(&res)) {
+        // odcisk iloczynu jest iloczynem odcisków
+        PolySetFingerprint(&res,
+                           FingerprintMul(pFingerprint, PolyGetFingerprint(q)));
+        PolyNormalize(&res);
+    }
 
     return res;
 }
 
-Poly PolyAddMonos(size_t count, const Mono monos[]) {
-    if (count == 0 || monos == NULL) {
-        return PolyZero();
-    }
-
-    Mono *monosArr = malloc(count * sizeof (Mono));
-    CHECK_PTR(monosArr);
-    memcpy(monosArr, monos, count * sizeof (Mono));
+/**
+ * To jest struktura opisująca równoległe mnożenie wielomianów.
+ */
+typedef struct {
+    const Poly *p; ///< pierwszy czynnik
+    const Poly *q; ///< drugi czynnik
+    size_t blocks; ///< liczba bloków jednomianów pierwszego czynnika
+    Poly *partial; ///< wyniki częściowe, po jednym na blok
+} PolyMulTask;
 
-    return PolyOwnMonos(count, monosArr);
+/**
+ * Mnoży @p i-ty blok jednomianów pierwszego czynnika przez drugi czynnik.
+ * @param[in,out] arg : opis mnożenia (PolyMulTask)
+ * @param[in] i : indeks bloku
+ */
+static void PolyMulBlock(void *arg, size_t i) {
+    PolyMulTask *task = arg;
+    size_t begin = ParBlockBegin(task->p->size, task->blocks, i);
+    size_t end = ParBlockBegin(task->p->size, task->blocks, i + 1);
+
+    Poly block = {.size = end - begin, .arr = task->p->arr + begin};
+    task->partial[i] = PolyMulSequential(
+        &block, task->q, MonoArrayFingerprint(block.size, block.arr));
 }
 
-Poly PolyCloneMonos(size_t count, const Mono monos[]) {
-    if (count == 0 || monos == NULL) {
-        return PolyZero();
-    }
+/**
+ * To jest struktura opisująca jeden poziom równoległego sumowania
+ * wielomianów w PolyTreeSum().
+ */
+typedef struct {
+    Poly *partial; ///< sumowane wielomiany
+    size_t step; ///< odległość sumowanych wielomianów
+} PolySumTask;
 
-    Mono *monosArr = malloc(count * sizeof (Mono));
-    CHECK_PTR(monosArr);
+/**
+ * Dodaje wielomian o indeksie @f$(2i + 1) \cdot step@f$ do wielomianu
+ * o indeksie @f$2i \cdot step@f$.
+ * @param[in,out] arg : opis sumowania (PolySumTask)
+ * @param[in] i : indeks pary
+ */
+static void PolySumPair(void *arg, size_t i) {
+    PolySumTask *task = arg;
+    size_t left = 2 * i * task->step, right = left + task->step;
 
-    for (size_t i = 0; i < count; ++i) {
-        monosArr[i] = MonoClone(&monos[i]);
+    task->partial[left] = PolyAddOwn(&task->partial[left],
+                                     &task->partial[right]);
+}
+
+/**
+ * Sumuje wielomiany parami na wątkach puli, w drzewie o głębokości
+ * @f$\log count@f$. Kolejność dodawania nie zależy od liczby wątków.
+ * Przejmuje na własność wielomiany z tablicy @p partial.
+ * @param[in] partial : sumowane wielomiany
+ * @param[in] count : liczba wielomianów, co najmniej 1
+ * @return suma wielomianów
+ */
+static Poly PolyTreeSum(Poly *partial, size_t count) {
+    PolySumTask task = {.partial = partial};
+
+    for (task.step = 1; task.step < count; task.step *= 2) {
+        PoolFor((count - task.step + 2 * task.step - 1) / (2 * task.step),
+                PolySumPair, &task);
     }
 
-    return PolyOwnMonos(count, monosArr);
+    return partial[0];
 }
 
 /**
- * Mnoży wielomian przez współczynnik.
- * Mnnożony wielomian jest modyfikowany.
+ * Mnoży dwa wielomiany, które nie są współczynnikami, na wątkach puli.
+ * Podział na bloki nie zależy od tego, który wątek wykonuje który blok,
+ * a wyniki częściowe sumowane są zawsze w tej samej kolejności.
  * @param[in] p : wielomian @f$p@f$
- * @param[in] c : współczynnik @f$c@f$
+ * @param[in] q : wielomian @f$q@f$
+ * @return @f$p * q@f$
  */
-static void PolyMulByCoeff(Poly *p, poly_coeff_t c);
+static Poly PolyMulParallel(const Poly *p, const Poly *q) {
+    size_t blocks = ParBlocks(p->size);
 
-/**
- * Mnoży jednomian przez współczynnik.
- * Mnnożony jednomian jest modyfikowany. Jest to funkcja pomocnicza dla
- * PolyMulByCoeff() i nie jest wywoływana w żadnym innym miejscu.
- * @param[in] m : jednomian @f$m@f$
- * @param[in] c : współczynnik @f$c@f$
- */
-static inline void MonoMulByCoeff(Mono *m, poly_coeff_t c) {
-    assert(c != 0);
-    PolyMulByCoeff(&m->p, c);
-}
+    PolyMulTask task = {.p = p, .q = q, .blocks = blocks,
+                        .partial = malloc(blocks * sizeof (Poly))};
+    CHECK_PTR(task.partial);
 
-static void PolyMulByCoeff(Poly *p, poly_coeff_t c) {
-    if (c == 0) {
-        PolyDestroy(p);
-        *p = PolyZero();
-    }
-    else if (c == 1) {
-        return;
-    }
-    else if (PolyIsCoeff(p)) {
-        p->coeff *= c;
-    }
-    else {
-        for (size_t i = 0; i < p->size; ++i) {
-            MonoMulByCoeff(&p->arr[i], c);
-        }
-    }
+    PoolFor(blocks, PolyMulBlock, &task);
+    Poly res = PolyTreeSum(task.partial, blocks);
+    free(task.partial);
+
+    return res;
 }
 
-/**
- * Mnoży dwa jednomiany.
- * @param[in] m : jednomian @f$m@f$
- * @param[in] n : jednomian @f$n@f$
- * @return @f$m * n@f$
- */
-static inline Mono MonoMul(const Mono *m, const Mono *n) {
-    return (Mono) {.p = PolyMul(&m->p, &n->p), .exp = m->exp + n->exp};
+void PolySetThreads(size_t count) {
+    PoolSetThreads(count);
 }
 
 Poly PolyMul(const Poly *p, const Poly *q) {
@@ -378,20 +2083,15 @@ Poly PolyMul(const Poly *p, const Poly *q) {
         return res;
     }
 
-    Mono *monos = malloc(p->size * q->size * sizeof (Mono));
-    CHECK_PTR(monos);
-    size_t k = 0;
-
-    for (size_t i = 0; i < p->size; ++i) {
-        for (size_t j = 0; j < q->size; ++j) {
-            monos[k++] = MonoMul(&p->arr[i], &q->arr[j]);
+    if (PoolThreads() > 1 && p->size > 1) {
+        size_t pTerms = PolyTermCount(p, PAR_MIN_WORK);
+        size_t qTerms = PolyTermCount(q, PAR_MIN_WORK);
+        if (pTerms * qTerms >= PAR_MIN_WORK) {
+            return PolyMulParallel(p, q);
         }
     }
 
-    Poly res = PolyAddMonos(k, monos);
-    free(monos);
-
-    return res;
+    return PolyMulSequential(p, q, PolyGetFingerprint(p));
 }
 
 Poly PolyNeg(const Poly *p) {
@@ -473,23 +2173,118 @@ poly_coeff_t FastPow(poly_coeff_t x, poly_exp_t n) {
     return res;
 }
 
+/**
+ * Wylicza wartość wielomianu, który jest liściem (zob. PolyIsLeaf()),
+ * w punkcie @p x schematem Hornera, od najwyższego wykładnika. Potęgi przy
+ * lukach między wykładnikami liczone są przez podnoszenie do kwadratu.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] x : wartość argumentu @f$x@f$
+ * @return @f$p(x)@f$
+ */
+static poly_coeff_t PolyLeafAt(const Poly *p, poly_coeff_t x) {
+    poly_coeff_t res = 0;
+    for (size_t i = p->size; i-- > 0;) {
+        poly_exp_t gap = p->arr[i].exp - (i > 0 ? p->arr[i - 1].exp : 0);
+        res = (res + p->arr[i].p.coeff) * (gap == 1 ? x : FastPow(x, gap));
+    }
+    return res;
+}
+
 Poly PolyAt(const Poly *p, poly_coeff_t x) {
     if (PolyIsCoeff(p)) {
         return PolyFromCoeff(p->coeff);
     }
+    if (PolyIsLeaf(p)) {
+        return PolyFromCoeff(PolyLeafAt(p, x));
+    }
 
-    Poly res = PolyZero();
+    PolyBucket sum = PolyBucketNew();
 
     for (size_t i = 0; i < p->size; ++i) {
         Poly tmp = PolyClone(&p->arr[i].p);
         PolyMulByCoeff(&tmp, FastPow(x, p->arr[i].exp));
-        Poly sum = PolyAdd(&res, &tmp);
-        PolyDestroy(&tmp);
-        PolyDestroy(&res);
-        res = sum;
+        PolyNormalize(&tmp);
+        PolyBucketAdd(&sum, &tmp);
     }
 
-    return res;
+    return PolyBucketSum(&sum);
+}
+
+/**
+ * To jest struktura opisująca równoległe wyliczanie wartości wielomianu
+ * w wielu punktach.
+ */
+typedef struct {
+    const Poly *p; ///< wielomian
+    const poly_coeff_t *x; ///< punkty
+    Poly *res; ///< wartości w punktach
+    size_t count; ///< liczba punktów
+    size_t blocks; ///< liczba bloków punktów
+    const poly_coeff_t *coeffs; ///< spakowane współczynniki liścia albo NULL
+    const poly_exp_t *gaps; ///< spakowane różnice wykładników liścia
+    poly_coeff_t *values; ///< wartości liścia w punktach
+} PolyAtTask;
+
+/**
+ * Wylicza wartości wielomianu w @p i-tym bloku punktów.
+ * @param[in,out] arg : opis obliczenia (PolyAtTask)
+ * @param[in] i : indeks bloku
+ */
+static void PolyAtBlock(void *arg, size_t i) {
+    PolyAtTask *task = arg;
+    size_t begin = ParBlockBegin(task->count, task->blocks, i);
+    size_t end = ParBlockBegin(task->count, task->blocks, i + 1);
+
+    if (task->coeffs != NULL) {
+        CoeffHorner(task->coeffs, task->gaps, task->p->size, task->x + begin,
+                    task->values + begin, end - begin);
+        for (size_t k = begin; k < end; ++k) {
+            task->res[k] = PolyFromCoeff(task->values[k]);
+        }
+    }
+    else {
+        for (size_t k = begin; k < end; ++k) {
+            task->res[k] = PolyAt(task->p, task->x[k]);
+        }
+    }
+}
+
+void PolyAtMany(const Poly *p, size_t count, const poly_coeff_t x[],
+                Poly res[]) {
+    if (count == 0) {
+        return;
+    }
+
+    PolyAtTask task = {.p = p, .x = x, .res = res, .count = count,
+                       .blocks = 1};
+    poly_coeff_t *coeffs = NULL;
+    poly_exp_t *gaps = NULL;
+    if (!PolyIsCoeff(p) && PolyIsLeaf(p)) {
+        // współczynniki od najwyższego wykładnika, dla jądra CoeffHorner()
+        coeffs = malloc(p->size * sizeof (poly_coeff_t));
+        gaps = malloc(p->size * sizeof (poly_exp_t));
+        task.values = malloc(count * sizeof (poly_coeff_t));
+        CHECK_PTR(coeffs);
+        CHECK_PTR(gaps);
+        CHECK_PTR(task.values);
+        for (size_t i = 0; i < p->size; ++i) {
+            size_t j = p->size - 1 - i;
+            coeffs[i] = p->arr[j].p.coeff;
+            gaps[i] = p->arr[j].exp - (j > 0 ? p->arr[j - 1].exp : 0);
+        }
+        task.coeffs = coeffs;
+        task.gaps = gaps;
+    }
+
+    if (PoolThreads() > 1 && count > 1 &&
+        count * PolyTermCount(p, PAR_MIN_WORK) >= PAR_MIN_WORK) {
+        task.blocks = ParBlocks(count);
+    }
+    PoolFor(task.blocks, PolyAtBlock, &task);
+
+    free(coeffs);
+    free(gaps);
+    free(task.values);
 }
 
 /**
@@ -504,6 +2299,19 @@ static inline bool MonoIsEq(const Mono *m, const Mono *n) {
 
 bool PolyIsEq(const Poly *p, const Poly *q) {
     assert(PolyIsSorted(p) && PolyIsSorted(q));
+    assert(FingerprintIsEq(PolyComputeFingerprint(p), PolyGetFingerprint(p)));
+    assert(FingerprintIsEq(PolyComputeFingerprint(q), PolyGetFingerprint(q)));
+
+    // równe wielomiany mają równe odciski, więc różne odciski wykluczają
+    // równość bez przeglądania wielomianów
+    if (!FingerprintIsEq(PolyGetFingerprint(p), PolyGetFingerprint(q))) {
+        return false;
+    }
+
+    // współdzielone zamrożone wielomiany mają tę samą tablicę jednomianów
+    if (!PolyIsCoeff(p) && p->arr == q->arr) {
+        return true;
+    }
 
     if (PolyIsCoeff(p) && PolyIsCoeff(q)) {
         return p->coeff == q->coeff;
@@ -525,33 +2333,137 @@ bool PolyIsEq(const Poly *p, const Poly *q) {
     return false;
 }
 
+/// rozmiar bufora pisarza, przez którego PolyPrint() wypisuje wielomian
+#define POLY_PRINT_BUFFER_SIZE 4096
+
+/// najmniejsza liczba składników wielomianu, który jest wypisywany
+/// równolegle
+#define PRINT_PAR_MIN_TERMS ((size_t)1 << 15)
+
+/// największa liczba jednomianów najwyższego poziomu w jednej rundzie
+/// równoległego wypisywania, ogranicza pamięć zajętą przez tekst rundy
+#define PRINT_PAR_ROUND_MONOS ((size_t)1 << 18)
+
+static void PolyWriteSeq(const Poly *p, Writer *writer);
+
 /**
- * Wpisuje jednomian zgodnie z przyjętą reprezentacją.
+ * Wypisuje jednomian zgodnie z przyjętą reprezentacją.
  * @param[in] m : jednomian
+ * @param[in,out] writer : pisarz
  */
-static void MonoPrint(const Mono *m) {
-    printf("(");
-    PolyPrint(&m->p, false);
-    printf(",%d)", m->exp);
+static void MonoWrite(const Mono *m, Writer *writer) {
+    WriteChar(writer, '(');
+    PolyWriteSeq(&m->p, writer);
+    WriteChar(writer, ',');
+    WriteLong(writer, m->exp);
+    WriteChar(writer, ')');
 }
 
-void PolyPrint(const Poly *p, bool newLine) {
-    assert(PolyIsSorted(p));
-
+/**
+ * Wypisuje wielomian zgodnie z przyjętą reprezentacją w wątku
+ * wywołującym.
+ * @param[in] p : wielomian
+ * @param[in,out] writer : pisarz
+ */
+static void PolyWriteSeq(const Poly *p, Writer *writer) {
     if (PolyIsCoeff(p)) {
-        printf("%ld", p->coeff);
+        WriteLong(writer, p->coeff);
     }
     else {
-        MonoPrint(&p->arr[0]);
+        MonoWrite(&p->arr[0], writer);
         for (size_t i = 1; i < p->size; ++i) {
-            printf("+");
-            MonoPrint(&p->arr[i]);
+            WriteChar(writer, '+');
+            MonoWrite(&p->arr[i], writer);
+        }
+    }
+}
+
+/**
+ * To jest struktura opisująca jedną rundę równoległego wypisywania
+ * wielomianu.
+ */
+typedef struct {
+    const Poly *p; ///< wypisywany wielomian
+    size_t begin; ///< pierwszy jednomian rundy
+    size_t size; ///< liczba jednomianów rundy
+    size_t blocks; ///< liczba bloków jednomianów
+    Writer *parts; ///< pisarze bez strumienia, po jednym na blok
+} PolyWriteTask;
+
+/**
+ * Wypisuje @p i-ty blok jednomianów rundy do pisarza tego bloku. Każdy
+ * jednomian poza pierwszym jednomianem wielomianu poprzedza znak '+', więc
+ * złączone teksty bloków są takie same jak przy wypisywaniu sekwencyjnym.
+ * @param[in,out] arg : opis rundy (PolyWriteTask)
+ * @param[in] i : indeks bloku
+ */
+static void PolyWriteBlock(void *arg, size_t i) {
+    PolyWriteTask *task = arg;
+    Writer *writer = &task->parts[i];
+    size_t end = task->begin + ParBlockBegin(task->size, task->blocks, i + 1);
+
+    for (size_t j = task->begin + ParBlockBegin(task->size, task->blocks, i);
+         j < end; ++j) {
+        if (j > 0) {
+            WriteChar(writer, '+');
+        }
+        MonoWrite(&task->p->arr[j], writer);
+    }
+}
+
+/**
+ * Wypisuje wielomian, formatując bloki jednomianów najwyższego poziomu
+ * równolegle, każdy do osobnego bufora. Bufory są wypisywane po kolei po
+ * każdej rundzie, więc pamięć zależy od długości rundy, a nie od długości
+ * całego tekstu.
+ * @param[in] p : wielomian
+ * @param[in,out] writer : pisarz
+ */
+static void PolyWriteParallel(const Poly *p, Writer *writer) {
+    PolyWriteTask task = {.p = p, .blocks = ParBlocks(p->size)};
+    task.parts = malloc(task.blocks * sizeof (Writer));
+    CHECK_PTR(task.parts);
+    for (size_t i = 0; i < task.blocks; ++i) {
+        task.parts[i] = WriterGrowing();
+    }
+
+    for (; task.begin < p->size; task.begin += task.size) {
+        task.size = p->size - task.begin;
+        if (task.size > PRINT_PAR_ROUND_MONOS) {
+            task.size = PRINT_PAR_ROUND_MONOS;
         }
+        PoolFor(task.blocks, PolyWriteBlock, &task);
+        WriterWriteParts(writer, task.parts, task.blocks);
+    }
+
+    for (size_t i = 0; i < task.blocks; ++i) {
+        WriterFree(&task.parts[i]);
     }
+    free(task.parts);
+}
+
+void PolyWrite(const Poly *p, Writer *writer) {
+    assert(PolyIsSorted(p));
+
+    if (PoolThreads() > 1 && writer->file != NULL && !PolyIsCoeff(p) &&
+        p->size > 1 && PolyTermCount(p, PRINT_PAR_MIN_TERMS) >=
+                       PRINT_PAR_MIN_TERMS) {
+        PolyWriteParallel(p, writer);
+    }
+    else {
+        PolyWriteSeq(p, writer);
+    }
+}
 
+void PolyPrint(const Poly *p, bool newLine) {
+    char buf[POLY_PRINT_BUFFER_SIZE];
+    Writer writer = WriterOnBuffer(stdout, buf, sizeof buf);
+
+    PolyWrite(p, &writer);
     if (newLine) {
-        printf("\n");
+        WriteChar(&writer, '\n');
     }
+    WriterFree(&writer);
 }
 
 /**
@@ -615,27 +2527,242 @@ static inline poly_coeff_t PolyComposeWithZeros(const Poly *p) {
     return res;
 }
 
-Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
+/**
+ * Składa wielomian tak jak PolyCompose(), gdy wiadomo, od którego indeksu
+ * wszystkie wielomiany @p q są liczbami. Wtedy złożenie na tym poziomie jest
+ * wyliczeniem wartości wielomianu.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba wielomianów @p q
+ * @param[in] q : tablica wielomianów
+ * @param[in] coeffsFrom : indeks, od którego wszystkie @p q są liczbami
+ * @return wynik złożenia
+ */
+static Poly PolyComposeFrom(const Poly *p, size_t k, const Poly q[],
+                            size_t coeffsFrom);
+
+/**
+ * Składa wielomian z liczbami @p q, czyli wylicza jego wartość w punkcie
+ * @f$(q_0, \ldots, q_{k-1}, 0, 0, \ldots)@f$. Na każdym poziomie używa
+ * schematu Hornera, od najwyższego wykładnika.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba wielomianów @p q
+ * @param[in] q : tablica współczynników
+ * @return wynik złożenia
+ */
+static poly_coeff_t PolyComposeWithCoeffs(const Poly *p, size_t k,
+                                          const Poly q[]) {
     if (k == 0) {
-        return PolyFromCoeff(PolyComposeWithZeros(p));
+        return PolyComposeWithZeros(p);
     }
     if (PolyIsCoeff(p)) {
-        return *p;
+        return p->coeff;
     }
 
-    Poly res = PolyZero();
+    poly_coeff_t x = q[0].coeff, res = 0;
+    for (size_t i = p->size; i-- > 0;) {
+        poly_exp_t gap = p->arr[i].exp - (i > 0 ? p->arr[i - 1].exp : 0);
+        res += PolyComposeWithCoeffs(&p->arr[i].p, k - 1, q + 1);
+        res *= gap == 1 ? x : FastPow(x, gap);
+    }
+    return res;
+}
+
+/**
+ * Sprawdza, czy wielomian jest jednomianem @f$c x_0^{d_0} x_1^{d_1} \cdots@f$,
+ * czyli czy na każdym poziomie ma tylko jeden jednomian. Współczynnik też
+ * jest jednomianem.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest jednomianem?
+ */
+static bool PolyIsMonomial(const Poly *p) {
+    while (!PolyIsCoeff(p)) {
+        if (p->size != 1) {
+            return false;
+        }
+        p = &p->arr[0].p;
+    }
+    return true;
+}
+
+/**
+ * Mnoży wielomian przez @p e-tą potęgę jednomianu
+ * @f$m = c x_0^{d_0} x_1^{d_1} \cdots@f$ bez mnożenia wielomianów:
+ * wykładniki na poziomie @f$i@f$ zwiększają się o @f$d_i e@f$, a liczby
+ * w liściach mnożone są przez @f$c^e@f$. Mnożony wielomian jest
+ * modyfikowany.
+ * @param[in,out] p : wielomian
+ * @param[in] m : jednomian (zob. PolyIsMonomial())
+ * @param[in] e : wykładnik
+ */
+static void PolyMulByMonomialPow(Poly *p, const Poly *m, poly_exp_t e) {
+    if (e == 0) {
+        return;
+    }
+    if (PolyIsCoeff(m)) {
+        PolyMulByCoeff(p, FastPow(m->coeff, e));
+        PolyNormalize(p);
+        return;
+    }
+    if (PolyIsZero(p)) {
+        return;
+    }
+
+    poly_exp_t shift = m->arr[0].exp * e;
+    if (PolyIsCoeff(p)) {
+        Poly inner = *p;
+        PolyMulByMonomialPow(&inner, &m->arr[0].p, e);
+        if (!PolyIsZero(&inner)) {
+            *p = PolyFormMono((Mono) {.p = inner, .exp = shift});
+            PolyNormalize(p);
+        }
+        else {
+            *p = inner;
+        }
+        return;
+    }
 
+    PolyMakeMutable(p);
     for (size_t i = 0; i < p->size; ++i) {
-        Poly qPow = PolyPow(&q[0], p->arr[i].exp);
-        Poly composed = PolyCompose(&p->arr[i].p, k - 1, q + 1);
+        PolyMulByMonomialPow(&p->arr[i].p, &m->arr[0].p, e);
+        p->arr[i].exp += shift;
+    }
+    // odcisk iloczynu jest iloczynem odcisków
+    PolyGetHeader(p)->fp = FingerprintMul(
+        PolyGetHeader(p)->fp, FingerprintPow(PolyGetFingerprint(m), e));
+    PolyNormalize(p);
+}
+
+/**
+ * Składa jednomiany @p p o indeksach z przedziału @f$[begin, end)@f$
+ * z wielomianami @p q i zwraca sumę wyników. Potęgi @f$q_0@f$ liczone są
+ * przyrostowo: wykładniki jednomianów rosną, więc kolejną potęgę
+ * otrzymujemy z poprzedniej, mnożąc ją przez potęgę o różnicy wykładników.
+ * Potęgi są lokalne dla wywołania, więc nie są współdzielone między
+ * wątkami. Jeśli @f$q_0@f$ jest jednomianem, w szczególności liczbą albo
+ * zmienną, złożenia współczynników mnożone są przez jego potęgi
+ * PolyMulByMonomialPow(), bez liczenia potęg i mnożenia wielomianów.
+ * @param[in] p : wielomian, który nie jest współczynnikiem
+ * @param[in] begin : indeks pierwszego jednomianu
+ * @param[in] end : indeks za ostatnim jednomianem
+ * @param[in] k : liczba wielomianów @p q, co najmniej 1
+ * @param[in] q : tablica wielomianów
+ * @param[in] coeffsFrom : indeks, od którego wszystkie @p q są liczbami
+ * @return suma złożeń jednomianów
+ */
+static Poly PolyComposeRange(const Poly *p, size_t begin, size_t end,
+                             size_t k, const Poly q[], size_t coeffsFrom) {
+    PolyBucket res = PolyBucketNew();
+
+    if (PolyIsMonomial(&q[0])) {
+        for (size_t i = begin; i < end; ++i) {
+            Poly composed = PolyComposeFrom(&p->arr[i].p, k - 1, q + 1,
+                                            coeffsFrom - 1);
+            PolyMulByMonomialPow(&composed, &q[0], p->arr[i].exp);
+            PolyBucketAdd(&res, &composed);
+        }
+        return PolyBucketSum(&res);
+    }
+
+    Poly qPow = PolyFromCoeff(1);
+    poly_exp_t qPowExp = 0;
+
+    for (size_t i = begin; i < end; ++i) {
+        Poly step = PolyPow(&q[0], p->arr[i].exp - qPowExp);
+        Poly tmp = qPow;
+        qPow = PolyMul(&qPow, &step);
+        qPowExp = p->arr[i].exp;
+        PolyDestroy(&tmp);
+        PolyDestroy(&step);
+
+        Poly composed = PolyComposeFrom(&p->arr[i].p, k - 1, q + 1,
+                                        coeffsFrom - 1);
         Poly multiplied = PolyMul(&composed, &qPow);
-        Poly tmp = res;
-        res = PolyAdd(&res, &multiplied);
-        PolyDestroy(&qPow);
+        PolyBucketAdd(&res, &multiplied);
         PolyDestroy(&composed);
-        PolyDestroy(&multiplied);
-        PolyDestroy(&tmp);
     }
 
+    PolyDestroy(&qPow);
+
+    return PolyBucketSum(&res);
+}
+
+/**
+ * To jest struktura opisująca równoległe złożenie wielomianów.
+ */
+typedef struct {
+    const Poly *p; ///< składany wielomian
+    size_t k; ///< liczba wielomianów q
+    const Poly *q; ///< wielomiany podstawiane pod zmienne
+    size_t coeffsFrom; ///< indeks, od którego wszystkie q są liczbami
+    size_t blocks; ///< liczba bloków jednomianów p
+    Poly *partial; ///< wyniki częściowe, po jednym na blok
+} PolyComposeTask;
+
+/**
+ * Składa @p i-ty blok jednomianów wielomianu p.
+ * @param[in,out] arg : opis złożenia (PolyComposeTask)
+ * @param[in] i : indeks bloku
+ */
+static void PolyComposeBlock(void *arg, size_t i) {
+    PolyComposeTask *task = arg;
+    size_t begin = ParBlockBegin(task->p->size, task->blocks, i);
+    size_t end = ParBlockBegin(task->p->size, task->blocks, i + 1);
+
+    task->partial[i] = PolyComposeRange(task->p, begin, end, task->k,
+                                        task->q, task->coeffsFrom);
+}
+
+/**
+ * Składa wielomian, który nie jest współczynnikiem, na wątkach puli.
+ * Jednomiany @p p dzielone są na bloki składane niezależnie, a wyniki
+ * bloków sumowane są parami.
+ * @param[in] p : wielomian, który nie jest współczynnikiem
+ * @param[in] k : liczba wielomianów @p q, co najmniej 1
+ * @param[in] q : tablica wielomianów
+ * @param[in] coeffsFrom : indeks, od którego wszystkie @p q są liczbami
+ * @return wynik złożenia
+ */
+static Poly PolyComposeParallel(const Poly *p, size_t k, const Poly q[],
+                                size_t coeffsFrom) {
+    size_t blocks = ParBlocks(p->size);
+
+    PolyComposeTask task = {.p = p, .k = k, .q = q, .coeffsFrom = coeffsFrom,
+                            .blocks = blocks,
+                            .partial = malloc(blocks * sizeof (Poly))};
+    CHECK_PTR(task.partial);
+
+    PoolFor(blocks, PolyComposeBlock, &task);
+    Poly res = PolyTreeSum(task.partial, blocks);
+    free(task.partial);
+
     return res;
-}
\ No newline at end of file
+}
+
+static Poly PolyComposeFrom(const Poly *p, size_t k, const Poly q[],
+                            size_t coeffsFrom) {
+    if (coeffsFrom == 0) {
+        // pod wszystkie zmienne podstawiamy liczby, więc wynik jest liczbą
+        return PolyFromCoeff(PolyComposeWithCoeffs(p, k, q));
+    }
+    if (PolyIsCoeff(p)) {
+        return *p;
+    }
+
+    if (PoolThreads() > 1 && p->size > 1) {
+        size_t pTerms = PolyTermCount(p, PAR_MIN_WORK);
+        size_t qTerms = PolyTermCount(&q[0], PAR_MIN_WORK);
+        if (pTerms * qTerms >= PAR_MIN_WORK) {
+            return PolyComposeParallel(p, k, q, coeffsFrom);
+        }
+    }
+
+    return PolyComposeRange(p, 0, p->size, k, q, coeffsFrom);
+}
+
+Poly PolyCompose(const Poly *p, size_t k, const Poly q[]) {
+    size_t coeffsFrom = k;
+    while (coeffsFrom > 0 && PolyIsCoeff(&q[coeffsFrom - 1])) {
+        coeffsFrom--;
+    }
+    return PolyComposeFrom(p, k, q, coeffsFrom);
+}
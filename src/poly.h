@@ -1,6 +1,37 @@
 /** @file
   Interfejs klasy wielomianów rzadkich wielu zmiennych
 
+  @par Bezpieczeństwo wątków
+  Biblioteka jest wielowejściowa: nie ma ukrytego wspólnego stanu
+  zmieniającego się w trakcie obliczeń, a pamięć podręczna małych tablic
+  jednomianów jest osobna dla każdego wątku. Gwarancje dla poszczególnych
+  funkcji są następujące.
+  - Funkcje, które jedynie czytają swoje argumenty: PolyClone(),
+    PolyIsFrozen(), MonoClone(), PolyAdd(), PolyAddMonos(), PolyCloneMonos(),
+    PolyMul(), PolyNeg(), PolySub(), PolyDegBy(), PolyDeg(), PolyIsEq(),
+    PolyFingerprint(), PolyAt(), PolyAtMany(), PolyCompose(), MonoGetExp(),
+    PolyFromCoeff(), PolyZero(), MonoFromPoly(), PolyMonosNew(), PolyIsCoeff()
+    i PolyIsZero(), mogą być wywoływane równocześnie z wielu wątków, także
+    na tych samych wielomianach, o ile żaden wątek ich w tym czasie nie
+    modyfikuje ani nie niszczy.
+  - Funkcje, które modyfikują lub przejmują na własność swoje argumenty:
+    PolyDestroy(), PolyDestroyDeferred(), MonoDestroy(), PolyFreeze(),
+    PolyOwnMonos(), PolyOwnSortedMonos(), PolyMonosResize(), PolyMonosFree(),
+    PolyBucketNew(), PolyBucketAdd() i PolyBucketSum(), mogą
+    być wywoływane równocześnie z wielu wątków na różnych argumentach. Argumentu nie może
+    w tym czasie używać żaden inny wątek. Różne kopie tego samego
+    zamrożonego wielomianu (zob. PolyFreeze()) są różnymi argumentami.
+  - PolyDestroyWait() może być wywoływana równocześnie z wielu wątków.
+  - PolyPrint() może być wywoływana równocześnie z wielu wątków, ale
+    wypisywane przez nie wiersze mogą się przeplatać. PolyWrite() może być
+    wywoływana równocześnie z wielu wątków z różnymi pisarzami.
+  - PolySetMulWorkingSet() i PolySetMulStrategy() zmieniają ustawienia
+    wspólne dla wszystkich wątków. Mogą być wywoływane w dowolnym momencie,
+    a zmiana dotyczy mnożeń rozpoczętych później. Ustawienia nie wpływają
+    na wyniki obliczeń.
+  - PolySetThreads() nie może być wywoływana równocześnie z żadną inną
+    funkcją biblioteki.
+
   @authors Jakub Pawlewicz <pan@mimuw.edu.pl>, Marcin Peczarski <marpe@mimuw.edu.pl>
   @copyright Uniwersytet Warszawski
   @date 2021
@@ -9,9 +40,12 @@
 #ifndef __POLY_H__
 #define __POLY_H__
 
+#include "write.h"
+
 #include <assert.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 
 /** To jest typ reprezentujący współczynniki. */
 typedef long poly_coeff_t;
@@ -115,6 +149,21 @@ static inline bool PolyIsZero(const Poly *p) {
  */
 void PolyDestroy(Poly *p);
 
+/**
+ * Usuwa wielomian z pamięci tak jak PolyDestroy(), ale duży wielomian
+ * przekazuje do usunięcia wątkowi sprzątającemu działającemu w tle, więc
+ * czas wywołania nie zależy od rozmiaru wielomianu. Mały wielomian jest
+ * usuwany od razu.
+ * @param[in] p : wielomian
+ */
+void PolyDestroyDeferred(Poly *p);
+
+/**
+ * Czeka, aż wątek sprzątający usunie wszystkie wielomiany przekazane mu
+ * przez PolyDestroyDeferred().
+ */
+void PolyDestroyWait(void);
+
 /**
  * Usuwa jednomian z pamięci.
  * @param[in] m : jednomian
@@ -124,12 +173,35 @@ static inline void MonoDestroy(Mono *m) {
 }
 
 /**
- * Robi pełną, głęboką kopię wielomianu.
+ * Robi pełną, głęboką kopię wielomianu. Zamrożone części wielomianu nie są
+ * kopiowane, tylko współdzielone: kopia zamrożonego wielomianu zajmuje
+ * stały czas i jest tym samym zamrożonym wielomianem.
  * @param[in] p : wielomian
  * @return skopiowany wielomian
  */
 Poly PolyClone(const Poly *p);
 
+/**
+ * Zamraża wielomian. Zamrożony wielomian jest niezmienny i ma atomowy
+ * licznik odwołań: PolyClone() zwiększa licznik zamiast kopiować wielomian,
+ * a PolyDestroy() zmniejsza go i zwalnia wielomian dopiero wtedy, gdy
+ * licznik spadnie do zera. Dzięki temu wiele wątków może równocześnie
+ * używać tego samego wielomianu, każdy przez własną kopię, bez kopiowania
+ * i bez blokad. Zamrożony wielomian może być argumentem wszystkich funkcji
+ * biblioteki. Funkcje, które przejmują wielomian na własność, przejmują
+ * jedno odwołanie do niego.
+ * @param[in,out] p : wielomian
+ */
+void PolyFreeze(Poly *p);
+
+/**
+ * Sprawdza, czy wielomian jest zamrożony. Współczynnik jest zawsze
+ * niezmienny, więc traktujemy go jak zamrożony.
+ * @param[in] p : wielomian
+ * @return Czy wielomian jest zamrożony?
+ */
+bool PolyIsFrozen(const Poly *p);
+
 /**
  * Robi pełną, głęboką kopię jednomianu.
  * @param[in] m : jednomian
@@ -159,6 +231,43 @@ Poly PolyAdd(const Poly *p, const Poly *q);
  */
 Poly PolyOwnMonos(size_t count, Mono *monos);
 
+/**
+ * Alokuje tablicę na @p count jednomianów, którą PolyOwnSortedMonos() może
+ * przejąć bez kopiowania. Tablica ma przed sobą miejsce na nagłówek
+ * wielomianu, więc musi być zwalniana przez PolyMonosFree(), a nie free().
+ * @param[in] count : rozmiar tablicy
+ * @return tablica jednomianów
+ */
+Mono *PolyMonosNew(size_t count);
+
+/**
+ * Zmienia rozmiar tablicy zaalokowanej przez PolyMonosNew(), zachowując jej
+ * zawartość.
+ * @param[in] monos : tablica jednomianów
+ * @param[in] count : nowy rozmiar tablicy
+ * @return tablica jednomianów
+ */
+Mono *PolyMonosResize(Mono *monos, size_t count);
+
+/**
+ * Zwalnia tablicę zaalokowaną przez PolyMonosNew(). Nie niszczy jednomianów.
+ * @param[in] monos : tablica jednomianów
+ */
+void PolyMonosFree(Mono *monos);
+
+/**
+ * Tworzy wielomian z jednomianów, które są już w postaci kanonicznej:
+ * wykładniki rosną ściśle, a żaden jednomian nie ma zerowego współczynnika.
+ * Nie sortuje, nie sumuje i nie kopiuje jednomianów, tylko przejmuje na
+ * własność tablicę @p monos, zaalokowaną przez PolyMonosNew(), i jej
+ * zawartość. Jeśli @p count jest równe zeru, tworzy wielomian tożsamościowo
+ * równy zeru.
+ * @param[in] count : liczba jednomianów
+ * @param[in] monos : tablica jednomianów, być może dłuższa niż @p count
+ * @return wielomian będący sumą jednomianów
+ */
+Poly PolyOwnSortedMonos(size_t count, Mono *monos);
+
 /**
  * Sumuje listę jednomianów i tworzy z nich wielomian.
  * Przejmuje na własność zawartość tablicy @p monos.
@@ -179,6 +288,43 @@ Poly PolyAddMonos(size_t count, const Mono monos[]);
  */
 Poly PolyCloneMonos(size_t count, const Mono monos[]);
 
+/** To jest liczba kubełków w strukturze \ref PolyBucket. */
+#define POLY_BUCKETS 30
+
+/**
+ * To jest struktura kubełków geometrycznych, służąca do sumowania długiego
+ * ciągu wielomianów. Kubełek o indeksie @f$i@f$ przechowuje wielomian
+ * o co najwyżej @f$4^{i+1}@f$ jednomianach. Dodawany wielomian trafia do
+ * najmniejszego kubełka, w którym się mieści, a suma, która przestaje się
+ * mieścić w kubełku, przenoszona jest do następnego. Dzięki temu suma
+ * @f$m@f$ wielomianów o łącznym rozmiarze @f$N@f$ kosztuje
+ * @f$O(N \log m)@f$ zamiast @f$O(N m)@f$.
+ */
+typedef struct PolyBucket {
+    Poly buckets[POLY_BUCKETS]; ///< kubełki
+} PolyBucket;
+
+/**
+ * Tworzy puste kubełki, czyli sumę równą zeru.
+ * @return kubełki
+ */
+PolyBucket PolyBucketNew(void);
+
+/**
+ * Dodaje wielomian do sumy przechowywanej w kubełkach.
+ * Przejmuje na własność zawartość struktury wskazywanej przez @p p.
+ * @param[in,out] b : kubełki
+ * @param[in] p : wielomian
+ */
+void PolyBucketAdd(PolyBucket *b, Poly *p);
+
+/**
+ * Sumuje zawartość kubełków i zwraca wynik. Po wywołaniu kubełki są puste.
+ * @param[in,out] b : kubełki
+ * @return suma wielomianów dodanych do kubełków
+ */
+Poly PolyBucketSum(PolyBucket *b);
+
 /**
  * Mnoży dwa wielomiany.
  * @param[in] p : wielomian @f$p@f$
@@ -187,6 +333,54 @@ Poly PolyCloneMonos(size_t count, const Mono monos[]);
  */
 Poly PolyMul(const Poly *p, const Poly *q);
 
+/**
+ * Ustawia limit pamięci roboczej mnożenia. PolyMul() wylicza iloczyny
+ * jednomianów porcjami i scala każdą porcję z wynikiem częściowym, zanim
+ * policzy następną. Porcja zajmuje co najwyżej @p bytes bajtów albo tyle,
+ * ile wynik częściowy, jeśli ten jest większy. Domyślny limit to 4 MiB.
+ * @param[in] bytes : limit pamięci roboczej w bajtach
+ */
+void PolySetMulWorkingSet(size_t bytes);
+
+/**
+ * To jest typ wyliczeniowy określający sposób, w jaki PolyMul() sumuje
+ * iloczyny jednomianów.
+ */
+typedef enum {
+    /** wybór zależny od tego, jak często powtarzają się wykładniki */
+    POLY_MUL_AUTO,
+    /** scalanie posortowanych porcji iloczynów */
+    POLY_MUL_MERGE,
+    /** sumowanie w tablicy z haszowaniem po wykładniku */
+    POLY_MUL_HASH
+} PolyMulStrategy;
+
+/**
+ * Ustawia sposób sumowania iloczynów jednomianów w PolyMul(). Domyślnie
+ * (#POLY_MUL_AUTO) tablica z haszowaniem wybierana jest wtedy, gdy
+ * przedział możliwych wykładników iloczynu nie jest większy od liczby
+ * iloczynów, czyli gdy wykładniki często się powtarzają i tablica pozostaje
+ * mała. Jeśli ponadto oba czynniki mają tylko współczynniki będące liczbami,
+ * a jeden z nich ma gęsto rozłożone wykładniki, iloczyn liczony jest
+ * wektorowo jako splot tablic współczynników indeksowanych wykładnikiem.
+ * @param[in] strategy : sposób sumowania iloczynów
+ */
+void PolySetMulStrategy(PolyMulStrategy strategy);
+
+/**
+ * Ustawia liczbę wątków, na których wykonywane są obliczenia. Przy więcej
+ * niż jednym wątku PolyMul() dzieli jednomiany pierwszego czynnika na bloki,
+ * mnoży bloki równolegle i sumuje wyniki częściowe parami, również
+ * równolegle. Tak samo PolyCompose() składa równolegle bloki jednomianów
+ * składanego wielomianu. Zagnieżdżone obliczenia na współczynnikach
+ * korzystają z tej samej puli wątków. Wynik nie zależy od liczby wątków. Domyślnie obliczenia są
+ * wykonywane na jednym wątku. Liczba wątków jest ograniczana do czterech
+ * na dostępny procesor. Nie może być wywoływana w trakcie obliczeń, także
+ * w innych wątkach.
+ * @param[in] count : liczba wątków
+ */
+void PolySetThreads(size_t count);
+
 /**
  * Zwraca przeciwny wielomian.
  * @param[in] p : wielomian @f$p@f$
@@ -229,6 +423,20 @@ poly_exp_t PolyDeg(const Poly *p);
  */
 bool PolyIsEq(const Poly *p, const Poly *q);
 
+/**
+ * Zwraca odcisk wielomianu, czyli jego wartość w ustalonym losowym punkcie
+ * @f$(r_0, r_1, r_2, r_3, r_0, \ldots)@f$ liczoną modulo @f$2^{64}@f$ (tak
+ * samo przekręcają się współczynniki). Zmienne różnią się punktami, więc
+ * wielomiany różniące się tylko nazwami zmiennych, np. @f$x_0@f$ i @f$x_1@f$,
+ * zwykle mają różne odciski. Odcisk jest przechowywany razem z wielomianem
+ * i aktualizowany w czasie stałym przez PolyAdd(), PolySub(), PolyNeg()
+ * i PolyMul(). Równe wielomiany mają równe odciski, więc PolyIsEq() porównuje
+ * najpierw odciski i pełne porównanie wykonuje tylko, gdy są one równe.
+ * @param[in] p : wielomian
+ * @return odcisk wielomianu
+ */
+uint64_t PolyFingerprint(const Poly *p);
+
 /**
  * Wylicza wartość wielomianu w punkcie @p x.
  * Wstawia pod pierwszą zmienną wielomianu wartość @p x.
@@ -242,6 +450,20 @@ bool PolyIsEq(const Poly *p, const Poly *q);
  */
 Poly PolyAt(const Poly *p, poly_coeff_t x);
 
+/**
+ * Wylicza wartości wielomianu w @p count punktach, czyli
+ * @f$res_i = @f$ PolyAt(@p p, @f$x_i)@f$. Jeśli wszystkie współczynniki
+ * wielomianu są liczbami, wartości liczone są schematem Hornera wektorowo,
+ * dla wielu punktów naraz. Przy więcej niż jednym wątku (zob.
+ * PolySetThreads()) punkty dzielone są na bloki liczone równolegle.
+ * @param[in] p : wielomian @f$p@f$
+ * @param[in] count : liczba punktów
+ * @param[in] x : tablica @p count punktów
+ * @param[out] res : tablica na @p count wartości
+ */
+void PolyAtMany(const Poly *p, size_t count, const poly_coeff_t x[],
+                Poly res[]);
+
 /**
  * Wpisuje wielomian zgodnie z przyjętą reprezentacją.
  * @param[in] p : wielomian
@@ -249,6 +471,17 @@ Poly PolyAt(const Poly *p, poly_coeff_t x);
  */
 void PolyPrint(const Poly *p, bool newLine);
 
+/**
+ * Wypisuje wielomian zgodnie z przyjętą reprezentacją przez pisarza, bez
+ * znaku nowej linii. Pisarz nie jest opróżniany, więc wiele wielomianów
+ * i odpowiedzi trafia do strumienia razem. Tekst wielomianu o bardzo wielu
+ * jednomianach jest przygotowywany równolegle na wątkach biblioteki, a potem
+ * wypisywany po kolei, więc wynik nie zależy od liczby wątków.
+ * @param[in] p : wielomian
+ * @param[in,out] writer : pisarz
+ */
+void PolyWrite(const Poly *p, Writer *writer);
+
 /**
  * Składa wielomiany. Operację składania wielomianów definiujemy w sposób
  * następujący. Niech @f$l@f$ oznacza liczbę zmiennych wielomianu @p p i niech
@@ -0,0 +1,654 @@
+/** @file
+  Testy wydajnościowe biblioteki wielomianów rzadkich wielu zmiennych.
+  Każdy test uruchamiany jest w osobnym procesie, dzięki czemu dla każdego
+  testu osobno mierzony jest czas działania, szczytowe zużycie pamięci (RSS)
+  oraz, jeśli system udostępnia liczniki sprzętowe, liczba chybień w pamięci
+  podręcznej.
+  Uruchomienie bez argumentów wykonuje wszystkie testy, a podanie nazw testów
+  jako argumentów wykonuje tylko wybrane.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#define _DEFAULT_SOURCE
+
+#include "poly.h"
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/** FUNKCJE POMOCNICZE **/
+
+/**
+ * Generator liczb pseudolosowych (xorshift), żeby dane testowe były takie
+ * same niezależnie od implementacji rand().
+ * @param[in,out] state : stan generatora
+ * @return kolejna liczba pseudolosowa
+ */
+static unsigned long long NextRandom(unsigned long long *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+/**
+ * Tworzy wielomian o @p size jednomianach na każdym z @p depth poziomów.
+ * Wykładniki kolejnych jednomianów rosną o losową wartość z przedziału
+ * @f$[1, step]@f$, a współczynniki są losowe z przedziału @f$[-100, 100]@f$.
+ * @param[in] size : liczba jednomianów na każdym poziomie
+ * @param[in] step : maksymalna różnica kolejnych wykładników
+ * @param[in] depth : liczba zmiennych
+ * @param[in,out] state : stan generatora liczb pseudolosowych
+ * @return wielomian
+ */
+static Poly RandomPoly(size_t size, poly_exp_t step, unsigned depth,
+                       unsigned long long *state) {
+    if (depth == 0) {
+        return PolyFromCoeff((poly_coeff_t)(NextRandom(state) % 201) - 100);
+    }
+
+    Mono *monos = malloc(size * sizeof (Mono));
+    if (monos == NULL) {
+        exit(1);
+    }
+
+    poly_exp_t exp = 0;
+    for (size_t i = 0; i < size; ++i) {
+        Poly p = RandomPoly(size, step, depth - 1, state);
+        monos[i] = MonoFromPoly(&p, exp);
+        exp += 1 + (poly_exp_t)(NextRandom(state) % (unsigned)step);
+    }
+
+    return PolyOwnMonos(size, monos);
+}
+
+/**
+ * Zwraca bieżący czas w sekundach.
+ * @return czas w sekundach
+ */
+static double Now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * Mnoży dwa losowe wielomiany.
+ * @param[in] pSize : liczba jednomianów pierwszego wielomianu na każdym poziomie
+ * @param[in] qSize : liczba jednomianów drugiego wielomianu na każdym poziomie
+ * @param[in] step : maksymalna różnica kolejnych wykładników
+ * @param[in] depth : liczba zmiennych
+ */
+static void MulRandom(size_t pSize, size_t qSize, poly_exp_t step,
+                      unsigned depth) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(pSize, step, depth, &state);
+    Poly q = RandomPoly(qSize, step, depth, &state);
+    Poly r = PolyMul(&p, &q);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&r);
+}
+
+/**
+ * Ustawia liczbę wątków biblioteki na liczbę dostępnych procesorów.
+ */
+static void UseAllCpus(void) {
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    PolySetThreads(cpus > 1 ? (size_t)cpus : 1);
+}
+
+/** TESTY WYDAJNOŚCIOWE **/
+
+/// mnożenie gęstych wielomianów jednej zmiennej, wynik jest mały
+static void MulDense(void) {
+    MulRandom(4000, 4000, 1, 1);
+}
+
+/// j.w., iloczyny scalane w posortowanych porcjach
+static void MulDenseMerge(void) {
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    MulRandom(4000, 4000, 1, 1);
+}
+
+/// j.w., ale przy limicie pamięci roboczej 64 KiB
+static void MulDenseSmallWorkingSet(void) {
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    PolySetMulWorkingSet((size_t)1 << 16);
+    MulRandom(4000, 4000, 1, 1);
+}
+
+/// j.w., iloczyny sumowane w tablicy z haszowaniem
+static void MulDenseHash(void) {
+    PolySetMulStrategy(POLY_MUL_HASH);
+    MulRandom(4000, 4000, 1, 1);
+}
+
+/// j.w., na wszystkich dostępnych procesorach
+static void MulDenseThreads(void) {
+    UseAllCpus();
+    MulRandom(4000, 4000, 1, 1);
+}
+
+/// mnożenie rzadkich wielomianów jednej zmiennej, wynik jest duży
+static void MulSparse(void) {
+    MulRandom(1500, 1500, 1000, 1);
+}
+
+/// j.w., iloczyny scalane w posortowanych porcjach
+static void MulSparseMerge(void) {
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    MulRandom(1500, 1500, 1000, 1);
+}
+
+/// j.w., iloczyny sumowane w tablicy z haszowaniem
+static void MulSparseHash(void) {
+    PolySetMulStrategy(POLY_MUL_HASH);
+    MulRandom(1500, 1500, 1000, 1);
+}
+
+/// mnożenie wielomianów o bardzo rozproszonych wykładnikach
+static void MulScattered(void) {
+    MulRandom(1500, 1500, 100000, 1);
+}
+
+/// j.w., iloczyny scalane w posortowanych porcjach
+static void MulScatteredMerge(void) {
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    MulRandom(1500, 1500, 100000, 1);
+}
+
+/// j.w., iloczyny sumowane w tablicy z haszowaniem
+static void MulScatteredHash(void) {
+    PolySetMulStrategy(POLY_MUL_HASH);
+    MulRandom(1500, 1500, 100000, 1);
+}
+
+/// mnożenie krótkiego wielomianu przez długi, którego jednomiany nie mieszczą
+/// się w pamięci podręcznej, iloczyny scalane w posortowanych porcjach
+static void MulLongMerge(void) {
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    MulRandom(64, 200000, 50, 1);
+}
+
+/// mnożenie wielomianów trzech zmiennych
+static void MulNested(void) {
+    MulRandom(14, 14, 2, 3);
+}
+
+/// j.w., na wszystkich dostępnych procesorach
+static void MulNestedThreads(void) {
+    UseAllCpus();
+    MulRandom(14, 14, 2, 3);
+}
+
+/// wartość w punkcie wielomianu dwóch zmiennych o wielu jednomianach,
+/// wynik jest sumą 1000 wielomianów o rzadko rozłożonych wykładnikach
+static void AtLong(void) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(1000, 1000, 2, &state);
+    Poly r = PolyAt(&p, 3);
+    PolyDestroy(&p);
+    PolyDestroy(&r);
+}
+
+/// liczba punktów w AtPoints() i AtMany()
+#define AT_POINTS 200000
+
+/**
+ * Wylicza wartości wielomianu jednej zmiennej o rzadko rozłożonych
+ * wykładnikach w wielu punktach.
+ * @param[in] many : Czy użyć PolyAtMany() zamiast PolyAt() dla każdego
+ *                   punktu?
+ */
+static void AtPointsRun(bool many) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(200, 3, 1, &state);
+    poly_coeff_t *x = malloc(AT_POINTS * sizeof (poly_coeff_t));
+    Poly *values = malloc(AT_POINTS * sizeof (Poly));
+    if (x == NULL || values == NULL) {
+        exit(1);
+    }
+    for (size_t k = 0; k < AT_POINTS; ++k) {
+        x[k] = (poly_coeff_t)NextRandom(&state);
+    }
+
+    if (many) {
+        PolyAtMany(&p, AT_POINTS, x, values);
+    }
+    else {
+        for (size_t k = 0; k < AT_POINTS; ++k) {
+            values[k] = PolyAt(&p, x[k]);
+        }
+    }
+
+    free(x);
+    free(values);
+    PolyDestroy(&p);
+}
+
+/// wartości wielomianu w wielu punktach, po jednym punkcie
+static void AtPoints(void) {
+    AtPointsRun(false);
+}
+
+/// j.w., wszystkie punkty naraz
+static void AtMany(void) {
+    AtPointsRun(true);
+}
+
+/// dodawanie wielomianów jednej zmiennej o milionach jednomianów
+static void AddWide(void) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(4000000, 2, 1, &state);
+    Poly q = RandomPoly(4000000, 2, 1, &state);
+    for (int i = 0; i < 5; ++i) {
+        Poly r = PolyAdd(&p, &q);
+        PolyDestroy(&r);
+    }
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+}
+
+/// j.w., na wszystkich dostępnych procesorach
+static void AddWideThreads(void) {
+    UseAllCpus();
+    AddWide();
+}
+
+/**
+ * Wielokrotnie bierze kopię dużego wielomianu bazowego, dodaje do niej mały
+ * wielomian i niszczy wynik, jak wątki obsługujące żądania na wspólnym
+ * wielomianie.
+ * @param[in] freeze : Czy wielomian bazowy ma być zamrożony?
+ */
+static void SharedBase(bool freeze) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly base = RandomPoly(300, 10, 2, &state);
+    Poly small = RandomPoly(3, 1000, 2, &state);
+    if (freeze) {
+        PolyFreeze(&base);
+    }
+    for (int i = 0; i < 200; ++i) {
+        Poly copy = PolyClone(&base);
+        Poly sum = PolyAdd(&copy, &small);
+        PolyDestroy(&copy);
+        PolyDestroy(&sum);
+    }
+    PolyDestroy(&base);
+    PolyDestroy(&small);
+}
+
+/// kopie wspólnego wielomianu bazowego są pełnymi kopiami
+static void SharedBaseClone(void) {
+    SharedBase(false);
+}
+
+/// kopie wspólnego zamrożonego wielomianu bazowego są współdzielone
+static void SharedBaseFrozen(void) {
+    SharedBase(true);
+}
+
+/// złożenie wielomianu dwóch zmiennych z wielomianami dwóch zmiennych
+static void Compose(void) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(12, 2, 2, &state);
+    Poly q[] = {RandomPoly(3, 1, 2, &state), RandomPoly(3, 1, 2, &state)};
+    Poly r = PolyCompose(&p, 2, q);
+    PolyDestroy(&p);
+    PolyDestroy(&q[0]);
+    PolyDestroy(&q[1]);
+    PolyDestroy(&r);
+}
+
+/// j.w., na wszystkich dostępnych procesorach
+static void ComposeThreads(void) {
+    UseAllCpus();
+    Compose();
+}
+
+/**
+ * Składa duży wielomian trzech zmiennych z podanymi wielomianami.
+ * @param[in] q : trzy wielomiany podstawiane pod zmienne
+ */
+static void ComposeWith(Poly q[]) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(40, 5, 3, &state);
+    Poly r = PolyCompose(&p, 3, q);
+    PolyDestroy(&p);
+    PolyDestroy(&r);
+    for (size_t i = 0; i < 3; ++i) {
+        PolyDestroy(&q[i]);
+    }
+}
+
+/// złożenie z liczbami, czyli wartość w punkcie
+static void ComposeConst(void) {
+    ComposeWith((Poly[]){PolyFromCoeff(3), PolyFromCoeff(-2),
+                         PolyFromCoeff(5)});
+}
+
+/// złożenie ze zmiennymi w innej kolejności
+static void ComposeRename(void) {
+    Mono x0 = {.p = PolyFromCoeff(1), .exp = 1};
+    Poly x[] = {PolyAddMonos(1, &x0), PolyZero(), PolyZero()};
+    for (size_t i = 1; i < 3; ++i) {
+        Mono m = {.p = PolyClone(&x[i - 1]), .exp = 0};
+        x[i] = PolyAddMonos(1, &m);
+    }
+    ComposeWith((Poly[]){x[2], x[0], x[1]});
+}
+
+/**
+ * Mierzy czas wykonania funkcji na kolejno 1, 2, ..., N wątkach i wypisuje
+ * przyspieszenie względem jednego wątku. N to liczba dostępnych procesorów
+ * albo wartość zmiennej środowiskowej POLY_THREADS, jeśli jest ustawiona.
+ * @param[in] name : nazwa mierzonego obliczenia
+ * @param[in] function : mierzone obliczenie
+ */
+static void Scaling(const char *name, void (*function)(void)) {
+    long maxThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("POLY_THREADS");
+    if (env != NULL && atol(env) > 0) {
+        maxThreads = atol(env);
+    }
+
+    double base = 0;
+    for (long threads = 1; threads <= maxThreads; ++threads) {
+        PolySetThreads((size_t)threads);
+        double start = Now();
+        function();
+        double elapsed = Now() - start;
+        base = threads == 1 ? elapsed : base;
+        printf("  %s on %ld threads: %.3f s, speedup %.2f\n", name, threads,
+               elapsed, base / elapsed);
+    }
+    PolySetThreads(1);
+}
+
+/// krzywa przyspieszenia mnożenia i złożenia w zależności od liczby wątków
+static void ScalingCurve(void) {
+    Scaling("MulDense", MulDense);
+    Scaling("MulScattered", MulScattered);
+    Scaling("MulNested", MulNested);
+    Scaling("Compose", Compose);
+}
+
+/// liczba rund obciążenia wykonywanych przez każdy wątek w StressThreads()
+#define STRESS_ROUNDS 3000
+
+/**
+ * Obciążenie jednego wątku w StressThreads(): w każdej rundzie tworzy
+ * własne wielomiany i wykonuje na nich działania jak w testach biblioteki.
+ * @param[in] arg : ziarno generatora liczb pseudolosowych (unsigned long long)
+ * @return NULL
+ */
+static void *StressWorker(void *arg) {
+    unsigned long long state = *(unsigned long long *)arg;
+
+    for (int round = 0; round < STRESS_ROUNDS; ++round) {
+        Poly p = RandomPoly(6, 3, 2, &state);
+        Poly q = RandomPoly(6, 3, 2, &state);
+        Poly sum = PolyAdd(&p, &q);
+        Poly diff = PolySub(&sum, &q);
+        Poly prod = PolyMul(&p, &q);
+        Poly at = PolyAt(&prod, 2);
+        Poly clone = PolyClone(&prod);
+        Poly small = RandomPoly(2, 1, 1, &state);
+        Poly comp = PolyCompose(&p, 2, (Poly[]){small, PolyFromCoeff(3)});
+
+        if (!PolyIsEq(&diff, &p) || !PolyIsEq(&clone, &prod) ||
+            PolyDeg(&prod) != PolyDeg(&p) + PolyDeg(&q) ||
+            PolyDegBy(&at, 0) > PolyDegBy(&prod, 1)) {
+            exit(1);
+        }
+
+        Poly *all[] = {&p, &q, &sum, &diff, &prod, &at, &clone, &small,
+                       &comp};
+        for (size_t i = 0; i < sizeof (all) / sizeof (all[0]); ++i) {
+            PolyDestroy(all[i]);
+        }
+    }
+
+    return NULL;
+}
+
+/// przepustowość biblioteki przy wielu wątkach wywołujących ją naraz, od
+/// jednego do N wątków (N jak w ScalingCurve), każdy z tym samym obciążeniem
+static void StressThreads(void) {
+    long maxThreads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *env = getenv("POLY_THREADS");
+    if (env != NULL && atol(env) > 0) {
+        maxThreads = atol(env);
+    }
+
+    pthread_t *threads = malloc(maxThreads * sizeof (pthread_t));
+    unsigned long long *seeds = malloc(maxThreads * sizeof (unsigned long long));
+    if (threads == NULL || seeds == NULL) {
+        exit(1);
+    }
+
+    double base = 0;
+    for (long count = 1; count <= maxThreads; ++count) {
+        double start = Now();
+        for (long i = 0; i < count; ++i) {
+            seeds[i] = 88172645463325252ULL + (unsigned long long)i;
+            if (pthread_create(&threads[i], NULL, StressWorker, &seeds[i]) != 0) {
+                exit(1);
+            }
+        }
+        for (long i = 0; i < count; ++i) {
+            pthread_join(threads[i], NULL);
+        }
+        double throughput = count * STRESS_ROUNDS / (Now() - start);
+        base = count == 1 ? throughput : base;
+        printf("  %ld threads: %.0f rounds/s, scaling %.2f\n", count,
+               throughput, throughput / base);
+    }
+
+    free(threads);
+    free(seeds);
+}
+
+/**
+ * Wypisuje wielomian przez pisarza do /dev/null i podaje przepustowość
+ * wypisywania. Liczba wypisanych bajtów mierzona jest wcześniej, przez
+ * wypisanie wielomianu do pliku tymczasowego.
+ * @param[in] p : wielomian
+ */
+static void PrintThroughput(const Poly *p) {
+    FILE *tmp = tmpfile();
+    FILE *null = fopen("/dev/null", "w");
+    if (tmp == NULL || null == NULL) {
+        exit(1);
+    }
+    Writer writer = WriterNew(tmp);
+    PolyWrite(p, &writer);
+    WriterFree(&writer);
+    double bytes = ftell(tmp);
+    fclose(tmp);
+
+    writer = WriterNew(null);
+    double start = Now();
+    PolyWrite(p, &writer);
+    WriterFree(&writer);
+    double elapsed = Now() - start;
+    fclose(null);
+
+    printf("  PRINT %.1f MB in %.3f s, %.1f MB/s\n", bytes / 1e6, elapsed,
+           bytes / 1e6 / elapsed);
+}
+
+/// wypisywanie wielomianu jednej zmiennej o milionach jednomianów
+static void PrintWide(void) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(4000000, 1000, 1, &state);
+    PrintThroughput(&p);
+    PolyDestroy(&p);
+}
+
+/// j.w., na wszystkich dostępnych procesorach
+static void PrintWideThreads(void) {
+    UseAllCpus();
+    PrintWide();
+}
+
+/// wypisywanie wielomianu trzech zmiennych, wiele krótkich jednomianów
+static void PrintNested(void) {
+    unsigned long long state = 88172645463325252ULL;
+    Poly p = RandomPoly(150, 3, 3, &state);
+    PrintThroughput(&p);
+    PolyDestroy(&p);
+}
+
+/** URUCHAMIANIE TESTÓW **/
+
+// Liczba elementów tablicy x
+#define SIZE(x) (sizeof (x) / sizeof (x)[0])
+
+typedef struct {
+    char const *name;
+    void (*function)(void);
+} bench_list_t;
+
+#define BENCH(t) {#t, t}
+
+static const bench_list_t bench_list[] = {
+        BENCH(MulDense),
+        BENCH(MulDenseMerge),
+        BENCH(MulDenseSmallWorkingSet),
+        BENCH(MulDenseHash),
+        BENCH(MulDenseThreads),
+        BENCH(MulSparse),
+        BENCH(MulSparseMerge),
+        BENCH(MulSparseHash),
+        BENCH(MulScattered),
+        BENCH(MulScatteredMerge),
+        BENCH(MulScatteredHash),
+        BENCH(MulLongMerge),
+        BENCH(MulNested),
+        BENCH(MulNestedThreads),
+        BENCH(AtLong),
+        BENCH(AtPoints),
+        BENCH(AtMany),
+        BENCH(AddWide),
+        BENCH(AddWideThreads),
+        BENCH(SharedBaseClone),
+        BENCH(SharedBaseFrozen),
+        BENCH(Compose),
+        BENCH(ComposeThreads),
+        BENCH(ComposeConst),
+        BENCH(ComposeRename),
+        BENCH(ScalingCurve),
+        BENCH(StressThreads),
+        BENCH(PrintWide),
+        BENCH(PrintWideThreads),
+        BENCH(PrintNested),
+};
+
+/**
+ * Otwiera licznik chybień w pamięci podręcznej dla bieżącego procesu.
+ * @return deskryptor licznika albo -1, jeśli liczniki sprzętowe są niedostępne
+ */
+static int CacheMissCounterOpen(void) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof attr);
+    attr.size = sizeof attr;
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+/**
+ * Uruchamia test w procesie potomnym i wypisuje czas jego działania,
+ * szczytowe zużycie pamięci i liczbę chybień w pamięci podręcznej.
+ * @param[in] bench : test
+ * @return Czy test zakończył się powodzeniem?
+ */
+static bool RunBench(const bench_list_t *bench) {
+    fflush(stdout);
+
+    // proces potomny przekazuje liczbę chybień przez łącze
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return false;
+    }
+
+    double start = Now();
+    pid_t pid = fork();
+
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        int counter = CacheMissCounterOpen();
+        bench->function();
+        long long misses = -1;
+        if (counter < 0 || read(counter, &misses, sizeof misses) !=
+                           (ssize_t)sizeof misses) {
+            misses = -1;
+        }
+        if (write(fds[1], &misses, sizeof misses) != (ssize_t)sizeof misses) {
+            _exit(1);
+        }
+        fflush(stdout);
+        _exit(0);
+    }
+
+    close(fds[1]);
+    long long misses = -1;
+    if (read(fds[0], &misses, sizeof misses) != (ssize_t)sizeof misses) {
+        misses = -1;
+    }
+    close(fds[0]);
+
+    int status;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+        printf("benchmark %s FAILED\n", bench->name);
+        return false;
+    }
+
+    printf("benchmark %s: %.3f s, peak RSS %ld KiB, ", bench->name,
+           Now() - start, usage.ru_maxrss);
+    if (misses < 0) {
+        printf("cache misses n/a\n");
+    }
+    else {
+        printf("cache misses %lld\n", misses);
+    }
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    size_t ctr = 0;
+
+    for (size_t i = 0; i < SIZE(bench_list); ++i) {
+        bool selected = argc == 1;
+        for (int j = 1; j < argc; ++j) {
+            selected |= strcmp(argv[j], bench_list[i].name) == 0;
+        }
+        if (selected && !RunBench(&bench_list[i])) {
+            ctr++;
+        }
+    }
+
+    return ctr == 0 ? 0 : 1;
+}
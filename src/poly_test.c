@@ -2,6 +2,9 @@
 #undef NDEBUG
 #endif
 
+#define _DEFAULT_SOURCE
+
+#include "coeff.h"
 #include "poly.h"
 #include <assert.h>
 #include <limits.h>
@@ -9,6 +12,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <pthread.h>
 #include <stdio.h>
 
 /** DANE DO TESTÓW **/
@@ -3172,6 +3176,52 @@ static bool SimpleComposeTest(void) {
     return res;
 }
 
+/**
+ * Podnosi wielomian do potęgi, mnożąc go @p n razy.
+ * @param[in] p : wielomian
+ * @param[in] n : wykładnik
+ * @return @f$p^n@f$
+ */
+static Poly NaivePow(const Poly *p, poly_exp_t n) {
+    Poly res = PolyFromCoeff(1);
+    for (poly_exp_t i = 0; i < n; ++i) {
+        Poly tmp = PolyMul(&res, p);
+        PolyDestroy(&res);
+        res = tmp;
+    }
+    return res;
+}
+
+/**
+ * Sprawdza złożenie wielomianu o nieregularnie rozłożonych wykładnikach.
+ */
+static bool ComposeTest(void) {
+    poly_exp_t exps[] = {0, 1, 2, 5, 9, 10, 30};
+    const size_t n = sizeof (exps) / sizeof (exps[0]);
+    Poly q[] = {P(P(C(1), 0, C(1), 1), 0, C(1), 2), P(C(-2), 0, C(1), 1)};
+
+    Mono *monos = malloc(n * sizeof (Mono));
+    Poly expected = PolyZero();
+    for (size_t i = 0; i < n; ++i) {
+        poly_coeff_t c = (poly_coeff_t)i - 3;
+        monos[i] = M(P(C(c), (poly_exp_t)(i % 3)), exps[i]);
+
+        Poly q0Pow = NaivePow(&q[0], exps[i]);
+        Poly q1Pow = NaivePow(&q[1], (poly_exp_t)(i % 3));
+        Poly term = PolyMul(&q0Pow, &q1Pow);
+        Poly scaled = PolyMul(&term, &(Poly){.coeff = c, .arr = NULL});
+        Poly sum = PolyAdd(&expected, &scaled);
+        PolyDestroy(&expected);
+        expected = sum;
+        PolyDestroy(&q0Pow);
+        PolyDestroy(&q1Pow);
+        PolyDestroy(&term);
+        PolyDestroy(&scaled);
+    }
+
+    return TestCompose(PolyOwnMonos(n, monos), 2, q, expected);
+}
+
 static bool SimpleMulTest(void) {
     bool res = true;
     res &= TestMul(C(2),
@@ -3272,6 +3322,473 @@ static bool OverflowTest(void) {
     return res;
 }
 
+static bool FingerprintTest(void) {
+    bool res = true;
+    Poly p = POLY_P;
+    Poly q = P(C(-3), 0, P(C(2), 1), 5);
+    Poly sum = PolyAdd(&p, &q);
+    Poly diff = PolySub(&p, &q);
+    Poly prod = PolyMul(&p, &q);
+    Poly neg = PolyNeg(&q);
+    res &= PolyFingerprint(&sum) == PolyFingerprint(&p) + PolyFingerprint(&q);
+    res &= PolyFingerprint(&diff) == PolyFingerprint(&p) - PolyFingerprint(&q);
+    res &= PolyFingerprint(&prod) == PolyFingerprint(&p) * PolyFingerprint(&q);
+    res &= PolyFingerprint(&neg) == -PolyFingerprint(&q);
+    // ten sam wielomian zbudowany w inny sposób ma ten sam odcisk
+    Poly back = PolyAdd(&diff, &q);
+    res &= PolyFingerprint(&back) == PolyFingerprint(&p);
+    res &= PolyIsEq(&back, &p);
+    res &= !PolyIsEq(&sum, &diff);
+    // wielomiany różniące się tylko nazwami zmiennych odrzuca sam odcisk
+    Poly x0 = P(C(1), 1);
+    Poly x1 = P(P(C(1), 1), 0);
+    Poly x0x1Sq = P(P(C(1), 2), 1);
+    Poly x0SqX1 = P(P(C(1), 1), 2);
+    res &= PolyFingerprint(&x0) != PolyFingerprint(&x1);
+    res &= !PolyIsEq(&x0, &x1);
+    res &= PolyFingerprint(&x0x1Sq) != PolyFingerprint(&x0SqX1);
+    res &= !PolyIsEq(&x0x1Sq, &x0SqX1);
+    // odcisk współczynnika przeniesionego na inną głębokość jest aktualny
+    Poly at = PolyAt(&x1, 7);
+    res &= PolyFingerprint(&at) == PolyFingerprint(&x0);
+    res &= PolyIsEq(&at, &x0);
+    PolyDestroy(&x0);
+    PolyDestroy(&x1);
+    PolyDestroy(&x0x1Sq);
+    PolyDestroy(&x0SqX1);
+    PolyDestroy(&at);
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&sum);
+    PolyDestroy(&diff);
+    PolyDestroy(&prod);
+    PolyDestroy(&neg);
+    PolyDestroy(&back);
+    return res;
+}
+
+static bool SortedMonosTest(void) {
+    bool res = true;
+    Mono monos[] = {
+        M(C(3), 0), M(P(C(1), 2, C(-4), 5), 1), M(C(-7), 4), M(C(1), 1000)
+    };
+    size_t count = sizeof (monos) / sizeof (monos[0]);
+
+    // tablica dłuższa niż liczba jednomianów, jak w parserze
+    Mono *arr = PolyMonosNew(2);
+    arr = PolyMonosResize(arr, 2 * count);
+    for (size_t i = 0; i < count; ++i) {
+        arr[i] = MonoClone(&monos[i]);
+    }
+    Poly p = PolyOwnSortedMonos(count, arr);
+    Poly expected = PolyAddMonos(count, monos);
+    res &= PolyIsEq(&p, &expected);
+    res &= PolyFingerprint(&p) == PolyFingerprint(&expected);
+    PolyDestroy(&p);
+    PolyDestroy(&expected);
+
+    // jedyny jednomian stopnia 0 ze współczynnikiem
+    arr = PolyMonosNew(1);
+    arr[0] = M(C(5), 0);
+    p = PolyOwnSortedMonos(1, arr);
+    res &= PolyIsCoeff(&p) && p.coeff == 5;
+
+    p = PolyOwnSortedMonos(0, PolyMonosNew(4));
+    res &= PolyIsZero(&p);
+
+    return res;
+}
+
+/**
+ * Sprawdza wypisywanie wielomianu przez pisarza z buforem tak małym, że jest
+ * on opróżniany w trakcie wypisywania liczb, także skrajnych.
+ */
+static bool WriteTest(void) {
+    bool res = true;
+    Poly p = P(P(C(LONG_MIN), 0, C(LONG_MAX), 7), 0, C(-1), 99, C(10), 100,
+               C(100), INT_MAX);
+    const char *expected = "((-9223372036854775808,0)+(9223372036854775807,7)"
+                           ",0)+(-1,99)+(10,100)+(100,2147483647)\n"
+                           "-99\n0\n";
+
+    FILE *file = tmpfile();
+    char buf[WRITE_LONG_MAX_LENGTH];
+    Writer writer = WriterOnBuffer(file, buf, sizeof buf);
+    PolyWrite(&p, &writer);
+    WriteChar(&writer, '\n');
+    WriteLong(&writer, -99);
+    WriteChar(&writer, '\n');
+    WriteLong(&writer, 0);
+    WriteChar(&writer, '\n');
+    WriterFree(&writer);
+
+    char out[200] = "";
+    rewind(file);
+    size_t length = fread(out, 1, sizeof out - 1, file);
+    res &= length == strlen(expected) && strcmp(out, expected) == 0;
+
+    fclose(file);
+    PolyDestroy(&p);
+    return res;
+}
+
+static bool BucketTest(void) {
+    bool res = true;
+    PolyBucket b = PolyBucketNew();
+    Poly sum = PolyZero();
+    for (poly_exp_t i = 0; i < 300; ++i) {
+        Poly p = P(C(i % 7 - 3), i % 11, P(C(i), 1, C(1), i % 5 + 2), i % 13 + 20);
+        Poly tmp = PolyAdd(&sum, &p);
+        PolyDestroy(&sum);
+        sum = tmp;
+        PolyBucketAdd(&b, &p);
+    }
+    Poly bucketSum = PolyBucketSum(&b);
+    res &= PolyIsEq(&sum, &bucketSum);
+    Poly empty = PolyBucketSum(&b);
+    res &= PolyIsZero(&empty);
+    PolyDestroy(&sum);
+    PolyDestroy(&bucketSum);
+    return res;
+}
+
+/**
+ * Sprawdza mnożenie wielomianów, których iloczyny nie mieszczą się
+ * w jednym kafelku ani w jednej porcji.
+ */
+static bool MulTileTest(void) {
+    bool res = true;
+    const size_t n = 300;
+    Mono *pm = malloc(n * sizeof (Mono));
+    Mono *qm = malloc(n * sizeof (Mono));
+    Mono *sm = malloc(n * sizeof (Mono));
+    for (size_t i = 0; i < n; ++i) {
+        pm[i] = M(C(1), (poly_exp_t)i);
+        qm[i] = M(C((poly_coeff_t)(i % 7) - 3), (poly_exp_t)(i * i % 1009));
+        sm[i] = M(P(C(1), 0, C((poly_coeff_t)i), 1), (poly_exp_t)(3 * i));
+    }
+    Poly p = PolyOwnMonos(n, pm);
+    Poly q = PolyOwnMonos(n, qm);
+    Poly s = PolyOwnMonos(n, sm);
+
+    // (1 + x + ... + x^(n-1)) * (x - 1) = x^n - 1, wyrazy skracają się
+    // między kafelkami
+    Poly xMinusOne = P(C(-1), 0, C(1), 1);
+    Poly telescope = P(C(-1), 0, C(1), (poly_exp_t)n);
+
+    PolyMulStrategy strategies[] = {POLY_MUL_MERGE, POLY_MUL_HASH};
+    size_t workingSets[] = {(size_t)1 << 22, 5000};
+    Poly expected = PolyZero();
+    for (size_t i = 0; i < 2; ++i) {
+        for (size_t j = 0; j < 2; ++j) {
+            PolySetMulStrategy(strategies[i]);
+            PolySetMulWorkingSet(workingSets[j]);
+            res &= TestOpPtr(&p, &xMinusOne, PolyClone(&telescope), PolyMul);
+            Poly r = PolyMul(&q, &s);
+            if (i == 0 && j == 0) {
+                expected = PolyClone(&r);
+            }
+            res &= PolyIsEq(&r, &expected);
+            PolyDestroy(&r);
+        }
+    }
+    PolySetMulStrategy(POLY_MUL_AUTO);
+    PolySetMulWorkingSet((size_t)1 << 22);
+
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&s);
+    PolyDestroy(&xMinusOne);
+    PolyDestroy(&telescope);
+    PolyDestroy(&expected);
+    return res;
+}
+
+/**
+ * Buduje wielomian dwóch zmiennych o @p n jednomianach na każdym poziomie.
+ * @param[in] n : liczba jednomianów
+ * @param[in] seed : wartość wpływająca na współczynniki
+ * @return wielomian
+ */
+static Poly MakeSquarePoly(size_t n, poly_coeff_t seed) {
+    Mono *monos = malloc(n * sizeof (Mono));
+    for (size_t i = 0; i < n; ++i) {
+        Mono *inner = malloc(n * sizeof (Mono));
+        for (size_t j = 0; j < n; ++j) {
+            inner[j] = M(C(((poly_coeff_t)(i * j) + seed) % 7 - 3), (poly_exp_t)j);
+        }
+        monos[i] = M(PolyOwnMonos(n, inner), (poly_exp_t)i);
+    }
+    return PolyOwnMonos(n, monos);
+}
+
+/**
+ * Składa wielomiany wprost z definicji, podnosząc @f$q_i@f$ do potęg
+ * mnożeniem.
+ * @param[in] p : wielomian
+ * @param[in] k : liczba wielomianów @p q
+ * @param[in] q : tablica wielomianów
+ * @return wynik złożenia
+ */
+static Poly NaiveCompose(const Poly *p, size_t k, const Poly q[]) {
+    if (PolyIsCoeff(p)) {
+        return PolyClone(p);
+    }
+    Poly res = PolyZero();
+    for (size_t i = 0; i < p->size; ++i) {
+        Poly composed = k > 0 ? NaiveCompose(&p->arr[i].p, k - 1, q + 1)
+                              : NaiveCompose(&p->arr[i].p, 0, q);
+        Poly pow = NaivePow(k > 0 ? &q[0] : &(Poly){.coeff = 0, .arr = NULL},
+                            p->arr[i].exp);
+        Poly term = PolyMul(&composed, &pow);
+        Poly sum = PolyAdd(&res, &term);
+        PolyDestroy(&res);
+        PolyDestroy(&composed);
+        PolyDestroy(&pow);
+        PolyDestroy(&term);
+        res = sum;
+    }
+    return res;
+}
+
+/**
+ * Sprawdza złożenia z liczbami, zmiennymi i jednomianami, które
+ * PolyCompose() liczy bez mnożenia wielomianów.
+ */
+static bool ComposeMonomialTest(void) {
+    bool res = true;
+    Poly x0 = P(C(1), 1);
+    Poly x1 = P(P(C(1), 1), 0);
+    Poly big = C(0x5DEECE66DL);
+    Poly mono = P(P(C(-2), 3), 1);
+    Poly general = P(C(1), 0, C(1), 1);
+    Poly polys[] = {
+        MakeSquarePoly(6, 1),
+        P(P(P(C(1), 1, C(2), 2), 0, C(-1), 3), 0, P(C(4), 1), 2, C(5), 7),
+        P(C(1), 0, C(-1), 40),
+    };
+    struct {
+        size_t k;
+        const Poly *q[4];
+    } cases[] = {
+        {1, {&big}},
+        {2, {&(Poly){.coeff = 2, .arr = NULL},
+             &(Poly){.coeff = -3, .arr = NULL}}},
+        {2, {&(Poly){.coeff = 0, .arr = NULL}, &big}},
+        {2, {&x0, &x1}},
+        {2, {&x1, &x0}},
+        {2, {&x0, &x0}},
+        {3, {&x1, &x1, &x0}},
+        {2, {&mono, &(Poly){.coeff = 5, .arr = NULL}}},
+        {2, {&(Poly){.coeff = -1, .arr = NULL}, &mono}},
+        {2, {&x1, &general}},
+        {2, {&general, &x0}},
+        {4, {&x0, &mono, &big, &x1}},
+    };
+
+    for (size_t i = 0; i < sizeof (polys) / sizeof (polys[0]); ++i) {
+        for (size_t j = 0; j < sizeof (cases) / sizeof (cases[0]); ++j) {
+            Poly q[4];
+            for (size_t l = 0; l < cases[j].k; ++l) {
+                q[l] = *cases[j].q[l];
+            }
+            Poly expected = NaiveCompose(&polys[i], cases[j].k, q);
+            Poly r = PolyCompose(&polys[i], cases[j].k, q);
+            res &= PolyIsEq(&r, &expected);
+            PolyDestroy(&r);
+            PolyDestroy(&expected);
+        }
+    }
+
+    for (size_t i = 0; i < sizeof (polys) / sizeof (polys[0]); ++i) {
+        PolyDestroy(&polys[i]);
+    }
+    PolyDestroy(&x0);
+    PolyDestroy(&x1);
+    PolyDestroy(&mono);
+    PolyDestroy(&general);
+    return res;
+}
+
+/**
+ * Sprawdza, że funkcje biblioteki przyjmują zamrożone wielomiany i dają te
+ * same wyniki co dla zwykłych, a zamrożony wielomian się nie zmienia.
+ */
+static bool FrozenTest(void) {
+    bool res = true;
+    Poly p = MakeSquarePoly(30, 1);
+    Poly q = MakeSquarePoly(20, 2);
+    Poly frozen = PolyClone(&p);
+    res &= !PolyIsFrozen(&frozen);
+    PolyFreeze(&frozen);
+    res &= PolyIsFrozen(&frozen) && PolyIsFrozen(&frozen.arr[0].p);
+
+    // kopia zamrożonego wielomianu jest tym samym wielomianem
+    Poly shared = PolyClone(&frozen);
+    res &= shared.arr == frozen.arr && PolyIsEq(&shared, &p);
+
+    Poly sum = PolyAdd(&p, &q);
+    Poly prod = PolyMul(&p, &q);
+    Poly neg = PolyNeg(&p);
+    Poly at = PolyAt(&p, 3);
+    Poly scaled = PolyMul(&p, &(Poly){.coeff = 5, .arr = NULL});
+    Poly small = P(C(1), 0, C(-1), 1);
+    Poly composed = PolyCompose(&p, 2, (Poly[]){small, C(2)});
+
+    res &= TestOpPtr(&frozen, &q, PolyClone(&sum), PolyAdd);
+    res &= TestOpPtr(&q, &frozen, PolyClone(&sum), PolyAdd);
+    res &= TestOpPtr(&frozen, &q, PolyClone(&prod), PolyMul);
+    res &= TestOpPtr(&frozen, &frozen, PolyZero(), PolySub);
+    res &= TestOpPtr(&frozen, &(Poly){.coeff = 5, .arr = NULL},
+                     PolyClone(&scaled), PolyMul);
+    Poly r = PolyNeg(&frozen);
+    res &= PolyIsEq(&r, &neg);
+    PolyDestroy(&r);
+    r = PolyAt(&frozen, 3);
+    res &= PolyIsEq(&r, &at);
+    PolyDestroy(&r);
+    r = PolyCompose(&frozen, 2, (Poly[]){small, C(2)});
+    res &= PolyIsEq(&r, &composed);
+    PolyDestroy(&r);
+
+    // funkcje przejmujące wielomiany na własność przejmują jedno odwołanie
+    PolyBucket b = PolyBucketNew();
+    Poly copy = PolyClone(&frozen);
+    PolyBucketAdd(&b, &copy);
+    copy = PolyClone(&q);
+    PolyBucketAdd(&b, &copy);
+    r = PolyBucketSum(&b);
+    res &= PolyIsEq(&r, &sum);
+    PolyDestroy(&r);
+    Mono *monos = malloc(2 * sizeof (Mono));
+    monos[0] = M(PolyClone(&frozen), 1);
+    monos[1] = M(PolyClone(&frozen), 1);
+    r = PolyOwnMonos(2, monos);
+    Poly twice = PolyAdd(&p, &p);
+    Poly expected = P(twice, 1);
+    res &= PolyIsEq(&r, &expected);
+    PolyDestroy(&r);
+    PolyDestroy(&expected);
+
+    // zamrożony wielomian się nie zmienił
+    res &= PolyIsEq(&frozen, &p) && shared.arr == frozen.arr;
+
+    PolyDestroy(&shared);
+    res &= PolyIsEq(&frozen, &p);
+    Poly *all[] = {&p, &q, &frozen, &sum, &prod, &neg, &at, &scaled,
+                   &small, &composed};
+    for (size_t i = 0; i < sizeof (all) / sizeof (all[0]); ++i) {
+        PolyDestroy(all[i]);
+    }
+    return res;
+}
+
+/// wspólny zamrożony wielomian w FrozenThreadsTest()
+static Poly frozenShared;
+
+/// oczekiwany iloczyn w FrozenThreadsTest()
+static Poly frozenExpected;
+
+/**
+ * Wątek testu FrozenThreadsTest(): kopiuje wspólny wielomian, używa go
+ * i niszczy kopie.
+ * @param[in] arg : wynik testu (bool)
+ * @return NULL
+ */
+static void *FrozenThreadsWorker(void *arg) {
+    bool *ok = arg;
+    *ok = true;
+    for (int i = 0; i < 50; ++i) {
+        Poly copy = PolyClone(&frozenShared);
+        Poly prod = PolyMul(&copy, &copy);
+        Poly sum = PolyAdd(&copy, &frozenShared);
+        Poly diff = PolySub(&sum, &copy);
+        *ok &= PolyIsEq(&prod, &frozenExpected) &&
+               PolyIsEq(&diff, &frozenShared);
+        PolyDestroy(&copy);
+        PolyDestroy(&prod);
+        PolyDestroy(&sum);
+        PolyDestroy(&diff);
+    }
+    return NULL;
+}
+
+/**
+ * Sprawdza używanie zamrożonego wielomianu przez wiele wątków naraz.
+ */
+static bool FrozenThreadsTest(void) {
+    enum { THREADS = 4 };
+    frozenShared = MakeSquarePoly(10, 3);
+    frozenExpected = PolyMul(&frozenShared, &frozenShared);
+    PolyFreeze(&frozenShared);
+
+    pthread_t threads[THREADS];
+    bool ok[THREADS];
+    for (size_t i = 0; i < THREADS; ++i) {
+        if (pthread_create(&threads[i], NULL, FrozenThreadsWorker, &ok[i]) != 0)
+            return false;
+    }
+    bool res = true;
+    for (size_t i = 0; i < THREADS; ++i) {
+        pthread_join(threads[i], NULL);
+        res &= ok[i];
+    }
+
+    PolyDestroy(&frozenShared);
+    PolyDestroy(&frozenExpected);
+    return res;
+}
+
+/**
+ * Buduje łańcuch zagnieżdżonych wielomianów o głębokości @p depth.
+ * Na kolejnych poziomach głębszy wielomian jest na przemian współczynnikiem
+ * pierwszego i ostatniego jednomianu.
+ * @param[in] depth : głębokość
+ * @return wielomian
+ */
+static Poly MakeDeepPoly(size_t depth) {
+    Poly p = C(1);
+    for (size_t i = 0; i < depth; ++i) {
+        Mono *monos = malloc(2 * sizeof (Mono));
+        monos[i % 2] = M(p, (poly_exp_t)(i % 2 + 1));
+        monos[1 - i % 2] = M(C(1), (poly_exp_t)(2 - i % 2));
+        p = PolyOwnMonos(2, monos);
+    }
+    return p;
+}
+
+/**
+ * Sprawdza usuwanie bardzo głębokich wielomianów i usuwanie wielomianów
+ * w tle. Poprawność zwalniania pamięci sprawdzają narzędzia takie jak
+ * valgrind.
+ */
+static bool DestroyTest(void) {
+    Poly deep = MakeDeepPoly(1000000);
+    PolyDestroy(&deep);
+    deep = MakeDeepPoly(1000000);
+    PolyDestroyDeferred(&deep);
+
+    Poly big = MakeSquarePoly(100, 1);
+    Poly small = MakeSquarePoly(3, 1);
+    Poly frozen = MakeSquarePoly(100, 2);
+    PolyFreeze(&frozen);
+    Poly copy = PolyClone(&frozen);
+    PolyDestroyDeferred(&big);
+    PolyDestroyDeferred(&small);
+    PolyDestroyDeferred(&copy);
+    Poly coeff = C(5);
+    PolyDestroyDeferred(&coeff);
+    PolyDestroyWait();
+
+    // zamrożony wielomian ma jeszcze jedno odwołanie
+    Poly expected = MakeSquarePoly(100, 2);
+    bool res = PolyIsEq(&frozen, &expected);
+    PolyDestroyDeferred(&frozen);
+    PolyDestroy(&expected);
+    PolyDestroyWait();
+    return res;
+}
+
 /** WŁAŚCIWE TESTY NIEUDOSTĘPNIONE W PRZYKŁADZIE **/
 
 /**
@@ -3956,6 +4473,418 @@ static bool MulTest2(void) {
     return good;
 }
 
+/**
+ * Sprawdza mnożenie przy limicie pamięci roboczej tak małym, że każdy
+ * iloczyn jednomianów jest scalany z wynikiem osobno.
+ */
+static bool MulWorkingSetTest(void) {
+    PolySetMulWorkingSet(1);
+    bool res = SimpleMulTest() && MulTest1() && MulTest2();
+    PolySetMulWorkingSet((size_t)1 << 22);
+    return res;
+}
+
+/**
+ * Sprawdza mnożenie każdym ze sposobów sumowania iloczynów jednomianów.
+ */
+static bool MulStrategyTest(void) {
+    bool res = true;
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    res &= SimpleMulTest() && MulTest1() && MulTest2();
+    PolySetMulStrategy(POLY_MUL_HASH);
+    res &= SimpleMulTest() && MulTest1() && MulTest2();
+    PolySetMulStrategy(POLY_MUL_AUTO);
+    return res;
+}
+
+/**
+ * Sprawdza mnożenie na wielu wątkach.
+ */
+static bool ParallelMulTest(void) {
+    bool res = true;
+    const size_t n = 40;
+    Mono *monos = malloc(n * sizeof (Mono));
+    for (size_t i = 0; i < n; ++i) {
+        Mono *inner = malloc(n * sizeof (Mono));
+        for (size_t j = 0; j < n; ++j) {
+            inner[j] = M(C((poly_coeff_t)((i * j) % 5) - 2), (poly_exp_t)(j * i % 17));
+        }
+        Poly coeff = PolyOwnMonos(n, inner);
+        monos[i] = M(coeff, (poly_exp_t)(2 * i));
+    }
+    Poly p = PolyOwnMonos(n, monos);
+    Poly expected = PolyMul(&p, &p);
+
+    PolySetThreads(4);
+    res &= SimpleMulTest() && MulTest1() && MulTest2() && MulTileTest();
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    res &= MulTest1() && MulTest2();
+    res &= TestOpPtr(&p, &p, PolyClone(&expected), PolyMul);
+    PolySetMulStrategy(POLY_MUL_AUTO);
+    res &= TestOpPtr(&p, &p, PolyClone(&expected), PolyMul);
+    PolySetThreads(1);
+
+    PolyDestroy(&p);
+    PolyDestroy(&expected);
+    return res;
+}
+
+/**
+ * Sprawdza złożenie na wielu wątkach.
+ */
+static bool ParallelComposeTest(void) {
+    bool res = true;
+    const size_t n = 60;
+    Mono *monos = malloc(n * sizeof (Mono));
+    for (size_t i = 0; i < n; ++i) {
+        monos[i] = M(P(C((poly_coeff_t)(i % 7) - 3), 0, C(1), (poly_exp_t)(i % 4 + 1)),
+                     (poly_exp_t)(i + i / 10));
+    }
+    Poly p = PolyOwnMonos(n, monos);
+    Poly q[] = {P(C(1), 0, P(C(2), 1), 1, C(-1), 3), P(C(3), 0, C(1), 2)};
+    Poly expected = PolyCompose(&p, 2, q);
+
+    PolySetThreads(4);
+    res &= SimpleComposeTest() && ComposeTest();
+    Poly composed = PolyCompose(&p, 2, q);
+    res &= PolyIsEq(&composed, &expected);
+    PolySetThreads(1);
+
+    PolyDestroy(&p);
+    PolyDestroy(&q[0]);
+    PolyDestroy(&q[1]);
+    PolyDestroy(&expected);
+    PolyDestroy(&composed);
+    return res;
+}
+
+/**
+ * Sprawdza dodawanie i kopiowanie na wielu wątkach dużych wielomianów,
+ * w tym takich, których suma ma zerowe jednomiany.
+ */
+static bool ParallelAddCloneTest(void) {
+    bool res = true;
+    const size_t n = 200;
+    Mono *pm = malloc(n * sizeof (Mono));
+    Mono *qm = malloc(n * sizeof (Mono));
+    for (size_t i = 0; i < n; ++i) {
+        Mono *inner = malloc(n * sizeof (Mono));
+        for (size_t j = 0; j < n; ++j) {
+            inner[j] = M(C((poly_coeff_t)(i + j) % 9 - 4), (poly_exp_t)j);
+        }
+        Poly coeff = PolyOwnMonos(n, inner);
+        pm[i] = M(coeff, (poly_exp_t)(2 * i));
+        // co drugi jednomian q znosi odpowiadający mu jednomian p
+        qm[i] = i % 2 == 0 ? M(PolyNeg(&coeff), (poly_exp_t)(2 * i))
+                           : M(C((poly_coeff_t)i), (poly_exp_t)(2 * i + 1));
+    }
+    Poly p = PolyOwnMonos(n, pm);
+    Poly q = PolyOwnMonos(n, qm);
+    Poly sum = PolyAdd(&p, &q);
+    Poly diff = PolySub(&p, &q);
+
+    PolySetThreads(4);
+    Poly clone = PolyClone(&p);
+    res &= PolyIsEq(&clone, &p);
+    res &= TestOpPtr(&p, &q, PolyClone(&sum), PolyAdd);
+    res &= TestOpPtr(&p, &q, PolyClone(&diff), PolySub);
+    res &= TestOpPtr(&p, &p, PolyZero(), PolySub);
+    PolySetThreads(1);
+
+    PolyDestroy(&p);
+    PolyDestroy(&q);
+    PolyDestroy(&sum);
+    PolyDestroy(&diff);
+    PolyDestroy(&clone);
+    return res;
+}
+
+/**
+ * Buduje wielomian jednej zmiennej o @p n jednomianach o wykładnikach
+ * @f$start, start + step, \ldots@f$ i współczynnikach zależnych od
+ * wykładnika.
+ * @param[in] n : liczba jednomianów
+ * @param[in] start : najmniejszy wykładnik
+ * @param[in] step : odstęp między wykładnikami
+ * @param[in] sign : znak współczynników
+ * @return wielomian
+ */
+static Poly MakeFlatPoly(size_t n, size_t start, size_t step,
+                         poly_coeff_t sign) {
+    Mono *monos = malloc(n * sizeof (Mono));
+    for (size_t i = 0; i < n; ++i) {
+        size_t exp = start + i * step;
+        monos[i] = M(C(sign * (poly_coeff_t)(exp % 7 + 1)), (poly_exp_t)exp);
+    }
+    return PolyOwnMonos(n, monos);
+}
+
+/**
+ * Wypisuje wielomian między dwiema liczbami przez pisarza z buforem
+ * @p bufSize znaków do pliku tymczasowego i daje wypisany tekst.
+ * @param[in] p : wielomian
+ * @param[in] bufSize : rozmiar bufora pisarza
+ * @param[in] memory : czy pisać do strumienia w pamięci, bez deskryptora?
+ * @param[out] length : długość tekstu
+ * @return tekst, do zwolnienia przez free()
+ */
+static char *WriteToText(const Poly *p, size_t bufSize, bool memory,
+                         size_t *length) {
+    char *text = NULL;
+    FILE *file = memory ? open_memstream(&text, length) : tmpfile();
+    char *buf = malloc(bufSize);
+    CHECK_PTR(file);
+    CHECK_PTR(buf);
+
+    Writer writer = WriterOnBuffer(file, buf, bufSize);
+    WriteLong(&writer, 17);
+    WriteChar(&writer, '\n');
+    PolyWrite(p, &writer);
+    WriteChar(&writer, '\n');
+    WriteLong(&writer, -17);
+    WriterFree(&writer);
+    free(buf);
+
+    if (!memory) {
+        *length = ftell(file);
+        text = malloc(*length);
+        CHECK_PTR(text);
+        rewind(file);
+        if (fread(text, 1, *length, file) != *length) {
+            *length = 0;
+        }
+    }
+    fclose(file);
+    return text;
+}
+
+/**
+ * Sprawdza, czy równoległe wypisywanie wielomianów daje ten sam tekst co
+ * sekwencyjne, także przy wielu rundach, wielomianie o niewielu
+ * jednomianach najwyższego poziomu i strumieniu bez deskryptora.
+ */
+static bool ParallelWriteTest(void) {
+    bool res = true;
+    Poly wide = MakeFlatPoly(300000, 0, 3, -1);
+    Poly inner = MakeFlatPoly(50000, 1, 1, 1);
+    Poly nested = P(C(LONG_MIN), 0, PolyClone(&inner), 1, inner, 7);
+    Poly *polys[] = {&wide, &nested};
+
+    for (size_t k = 0; k < sizeof (polys) / sizeof (polys[0]); ++k) {
+        size_t expectedLength;
+        char *expected = WriteToText(polys[k], 1 << 16, false,
+                                     &expectedLength);
+
+        for (size_t threads = 2; threads <= 5; ++threads) {
+            PolySetThreads(threads);
+            for (int memory = 0; memory <= 1; ++memory) {
+                size_t length;
+                char *text = WriteToText(polys[k], 64 * threads, memory,
+                                         &length);
+                res &= length == expectedLength &&
+                       memcmp(text, expected, length) == 0;
+                free(text);
+            }
+        }
+        PolySetThreads(1);
+        free(expected);
+        PolyDestroy(polys[k]);
+    }
+    return res;
+}
+
+/**
+ * Sprawdza równoległe scalanie szerokich wielomianów w PolyAdd() przy
+ * różnych podziałach na bloki, także gdy jednomiany o równych wykładnikach
+ * leżą na granicach bloków i gdy suma się skraca.
+ */
+static bool ParallelMergeAddTest(void) {
+    bool res = true;
+    enum { count = 5 };
+    Poly polys[count] = {
+        MakeFlatPoly(60000, 0, 2, 1),
+        MakeFlatPoly(40000, 0, 3, 1),
+        MakeFlatPoly(20000, 90000, 1, 1),
+        MakeFlatPoly(60000, 0, 2, -1),
+        MakeFlatPoly(30000, 1, 4, -1),
+    };
+    Poly sums[count][count];
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            sums[i][j] = PolyAdd(&polys[i], &polys[j]);
+        }
+    }
+
+    for (size_t threads = 2; threads <= 5; ++threads) {
+        PolySetThreads(threads);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = 0; j < count; ++j) {
+                res &= TestOpPtr(&polys[i], &polys[j], PolyClone(&sums[i][j]),
+                                 PolyAdd);
+            }
+        }
+        // wielomian przeciwny skraca się do zera
+        res &= TestOpPtr(&polys[0], &polys[3], PolyZero(), PolyAdd);
+        Poly shifted = PolyAdd(&polys[3], &(Poly){.coeff = 5, .arr = NULL});
+        res &= TestOpPtr(&polys[0], &shifted, C(5), PolyAdd);
+        PolyDestroy(&shifted);
+    }
+    PolySetThreads(1);
+
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            PolyDestroy(&sums[i][j]);
+        }
+        PolyDestroy(&polys[i]);
+    }
+    return res;
+}
+
+/**
+ * Buduje wielomian jednej zmiennej o @p n jednomianach o wykładnikach
+ * @f$start, start + step, \ldots@f$ i dużych współczynnikach, których
+ * iloczyny się przepełniają.
+ * @param[in] n : liczba jednomianów
+ * @param[in] start : najmniejszy wykładnik
+ * @param[in] step : odstęp między wykładnikami
+ * @return wielomian
+ */
+static Poly MakeOverflowPoly(size_t n, size_t start, size_t step) {
+    Mono *monos = malloc(n * sizeof (Mono));
+    for (size_t i = 0; i < n; ++i) {
+        poly_coeff_t coeff = (poly_coeff_t)(i * 0x9E3779B97F4A7C15ULL | 1);
+        monos[i] = M(C(coeff), (poly_exp_t)(start + i * step));
+    }
+    return PolyOwnMonos(n, monos);
+}
+
+/**
+ * Sprawdza mnożenie splotem gęstych tablic współczynników na wszystkich
+ * zestawach instrukcji, porównując wyniki ze scalaniem posortowanych
+ * porcji iloczynów.
+ */
+static bool DenseMulTest(void) {
+    bool res = true;
+    enum { count = 6 };
+    Poly polys[count] = {
+        MakeFlatPoly(300, 0, 1, 1),
+        MakeFlatPoly(37, 5, 1, -1),
+        MakeFlatPoly(50, 3, 3, 1),
+        MakeOverflowPoly(101, 0, 1),
+        MakeOverflowPoly(10, 1000, 1),
+        P(C(1), 0, C(1), 1),
+    };
+    Poly expected[count][count];
+    PolySetMulStrategy(POLY_MUL_MERGE);
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            expected[i][j] = PolyMul(&polys[i], &polys[j]);
+        }
+    }
+    PolySetMulStrategy(POLY_MUL_AUTO);
+
+    for (int isa = COEFF_ISA_SCALAR; isa <= COEFF_ISA_AVX512; ++isa) {
+        CoeffSetMaxIsa(isa);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t j = 0; j < count; ++j) {
+                res &= TestOpPtr(&polys[i], &polys[j],
+                                 PolyClone(&expected[i][j]), PolyMul);
+            }
+        }
+        // (1 - x)(1 + x + ... + x^9) = 1 - x^10, (x - x) * x = 0
+        Poly geometric = MakeFlatPoly(1, 0, 1, 1);
+        for (poly_exp_t e = 1; e < 10; ++e) {
+            Poly term = P(C(1), e);
+            Poly sum = PolyAdd(&geometric, &term);
+            PolyDestroy(&geometric);
+            PolyDestroy(&term);
+            geometric = sum;
+        }
+        res &= TestOpCopy(P(C(1), 0, C(-1), 1), geometric,
+                      P(C(1), 0, C(-1), 10), PolyMul);
+        res &= TestOpCopy(P(C(1), 1), P(C(0), 1), C(0), PolyMul);
+    }
+    CoeffSetMaxIsa(COEFF_ISA_AVX512);
+
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t j = 0; j < count; ++j) {
+            PolyDestroy(&expected[i][j]);
+        }
+        PolyDestroy(&polys[i]);
+    }
+    return res;
+}
+
+/**
+ * Wylicza naiwnie wartość wielomianu jednej zmiennej o współczynnikach
+ * będących liczbami, jednomian po jednomianie.
+ * @param[in] p : wielomian
+ * @param[in] x : punkt
+ * @return wartość wielomianu w punkcie
+ */
+static poly_coeff_t NaiveAt(const Poly *p, poly_coeff_t x) {
+    if (PolyIsCoeff(p)) {
+        return p->coeff;
+    }
+    uint64_t res = 0;
+    for (size_t i = 0; i < p->size; ++i) {
+        uint64_t pow = 1;
+        for (poly_exp_t e = 0; e < p->arr[i].exp; ++e) {
+            pow *= (uint64_t)x;
+        }
+        res += (uint64_t)p->arr[i].p.coeff * pow;
+    }
+    return (poly_coeff_t)res;
+}
+
+/**
+ * Sprawdza wyliczanie wartości wielomianu w wielu punktach na wszystkich
+ * zestawach instrukcji i na wielu wątkach.
+ */
+static bool AtManyTest(void) {
+    bool res = true;
+    enum { count = 5, points = 1003 };
+    Poly polys[count] = {
+        MakeFlatPoly(300, 0, 1, 1),
+        MakeFlatPoly(40, 7, 13, -1),
+        MakeOverflowPoly(50, 3, 2),
+        C(42),
+        P(P(C(1), 2), 0, C(3), 5),
+    };
+    poly_coeff_t x[points];
+    for (size_t k = 0; k < points; ++k) {
+        x[k] = (poly_coeff_t)(k * 0x9E3779B97F4A7C15ULL) >> (k % 64);
+    }
+    x[0] = 0;
+    x[1] = 1;
+    x[2] = -1;
+
+    Poly values[points];
+    for (size_t threads = 1; threads <= 4; threads += 3) {
+        PolySetThreads(threads);
+        for (int isa = COEFF_ISA_SCALAR; isa <= COEFF_ISA_AVX512; ++isa) {
+            CoeffSetMaxIsa(isa);
+            for (size_t i = 0; i < count; ++i) {
+                PolyAtMany(&polys[i], points, x, values);
+                for (size_t k = 0; k < points; ++k) {
+                    Poly expected = i == count - 1 ? PolyAt(&polys[i], x[k])
+                                                   : C(NaiveAt(&polys[i], x[k]));
+                    res &= PolyIsEq(&values[k], &expected);
+                    PolyDestroy(&expected);
+                    PolyDestroy(&values[k]);
+                }
+            }
+        }
+    }
+    CoeffSetMaxIsa(COEFF_ISA_AVX512);
+    PolySetThreads(1);
+
+    for (size_t i = 0; i < count; ++i) {
+        PolyDestroy(&polys[i]);
+    }
+    return res;
+}
+
 /**
  * Sprawdza poprawność działania funkcji PolyIsEq na dłuższych przykładach.
  */
@@ -4171,6 +5100,15 @@ static const test_list_t test_list[] = {
         TEST(SubTest1),
         TEST(SubTest2),
         TEST(ArithmeticGroup),
+        TEST(MulWorkingSetTest),
+        TEST(MulStrategyTest),
+        TEST(DenseMulTest),
+        TEST(AtManyTest),
+        TEST(ParallelMulTest),
+        TEST(ParallelComposeTest),
+        TEST(ParallelAddCloneTest),
+        TEST(ParallelMergeAddTest),
+        TEST(ParallelWriteTest),
         TEST(IsEqTest),
         TEST(RarePolynomialTest),
         TEST(MemoryThiefTest),
@@ -4178,7 +5116,17 @@ static const test_list_t test_list[] = {
         TEST(MemoryGroup),
         TEST(SimpleOwnMonosTest),
         TEST(SimpleCloneMonosTest),
+        TEST(SortedMonosTest),
+        TEST(WriteTest),
         TEST(SimpleComposeTest),
+        TEST(ComposeTest),
+        TEST(ComposeMonomialTest),
+        TEST(FingerprintTest),
+        TEST(BucketTest),
+        TEST(MulTileTest),
+        TEST(FrozenTest),
+        TEST(FrozenThreadsTest),
+        TEST(DestroyTest),
 };
 
 int main() {
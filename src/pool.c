@@ -0,0 +1,378 @@
+/** @file
+  Implementacja puli wątków z podkradaniem zadań (ang. work stealing).
+
+  Każdy wątek puli ma własną kolejkę dwustronną zadań (Chase, Lev). Właściciel
+  dokłada i zdejmuje zadania z dołu kolejki bez blokowania, a pozostałe wątki
+  podkradają zadania z góry. PoolFor() dzieli przedział indeksów na połowy:
+  prawą połowę wystawia jako zadanie do podkradnięcia (fork), lewą wykonuje
+  sam, a potem czeka na prawą (join). Jeśli nikt jej nie podkradł, wykonuje ją
+  sam, w przeciwnym razie do czasu jej zakończenia podkrada inne zadania.
+  Wątki spoza puli, które zlecają pracę, dostają na czas zlecenia jedną
+  z zewnętrznych kolejek.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#define _DEFAULT_SOURCE
+
+#include "pool.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+/**
+ * Sprawdza, czy udało się zaalokować pamięć. Jeśli nie, kończy działanie
+ * programu z kodem 1.
+ * @param[in] p : wskaźnik zwrócony przez funkcję alokującą pamięć
+ */
+#define CHECK_PTR(p)        \
+    do {                    \
+        if (p == NULL) {    \
+            exit(1);        \
+        }                   \
+    } while (0)
+
+/// pojemność kolejki zadań wątku (potęga dwójki); gdy kolejka jest pełna,
+/// zadanie wykonywane jest od razu, bez wystawiania go innym wątkom
+#define POOL_DEQUE_SIZE 1024
+
+/// liczba kolejek dla wątków spoza puli zlecających pracę jednocześnie
+#define POOL_EXTERNAL_DEQUES 8
+
+/// liczba nieudanych prób podkradania, po których wątek puli zasypia
+#define POOL_SPIN 64
+
+/// największa liczba wątków puli na jeden procesor; więcej wątków nie
+/// przyspiesza obliczeń, a każdy zajmuje pamięć na swój stos
+#define POOL_THREADS_PER_CPU 4
+
+/**
+ * To jest struktura zadania: wywołań funkcji dla indeksów z przedziału
+ * @f$[begin, end)@f$.
+ */
+typedef struct {
+    PoolFunction function; ///< funkcja wykonująca zadanie
+    void *arg; ///< argument funkcji
+    size_t begin; ///< pierwszy indeks
+    size_t end; ///< indeks za ostatnim
+    atomic_bool done; ///< Czy zadanie zostało wykonane?
+} PoolTask;
+
+/**
+ * To jest struktura kolejki dwustronnej zadań wątku.
+ */
+typedef struct {
+    atomic_long top; ///< indeks najstarszego zadania, stąd się podkrada
+    atomic_long bottom; ///< indeks za najnowszym zadaniem
+    _Atomic(PoolTask *) tasks[POOL_DEQUE_SIZE]; ///< bufor cykliczny zadań
+    atomic_bool used; ///< Czy kolejka zewnętrzna ma właściciela?
+} PoolDeque;
+
+static PoolDeque *poolDeques = NULL; ///< kolejki wątków puli i zewnętrzne
+static size_t poolDequeCount = 0; ///< liczba kolejek
+static pthread_t *poolWorkers = NULL; ///< wątki puli
+static size_t poolWorkerCount = 0; ///< liczba wątków puli
+static atomic_bool poolShutdown; ///< Czy wątki puli mają się zakończyć?
+static atomic_int poolSleepers; ///< liczba uśpionych wątków puli
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER; ///< muteks usypiania
+static pthread_cond_t poolCond = PTHREAD_COND_INITIALIZER; ///< budzenie wątków puli
+
+/// kolejka bieżącego wątku albo NULL, jeśli wątek jej nie ma
+static _Thread_local PoolDeque *poolSelf = NULL;
+
+/// stan generatora liczb pseudolosowych wybierającego ofiarę podkradania
+static _Thread_local unsigned poolRandom = 1;
+
+/**
+ * Wkłada zadanie na dół własnej kolejki.
+ * @param[in,out] d : kolejka bieżącego wątku
+ * @param[in] task : zadanie
+ * @return Czy w kolejce było miejsce?
+ */
+static bool PoolDequePush(PoolDeque *d, PoolTask *task) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    if (b - t >= POOL_DEQUE_SIZE) {
+        return false;
+    }
+
+    atomic_store_explicit(&d->tasks[b & (POOL_DEQUE_SIZE - 1)], task,
+                          memory_order_relaxed);
+    // publikuje zadanie podkradającym, którzy czytają bottom z acquire
+    atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+    return true;
+}
+
+/**
+ * Zdejmuje zadanie z dołu własnej kolejki.
+ * @param[in,out] d : kolejka bieżącego wątku
+ * @return zadanie albo NULL, jeśli kolejka jest pusta
+ */
+static PoolTask *PoolDequePop(PoolDeque *d) {
+    long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+    atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+
+    if (t > b) {
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+        return NULL;
+    }
+
+    PoolTask *task = atomic_load_explicit(&d->tasks[b & (POOL_DEQUE_SIZE - 1)],
+                                          memory_order_relaxed);
+    if (t == b) {
+        // ostatnie zadanie, ścigamy się o nie z podkradającymi
+        if (!atomic_compare_exchange_strong_explicit(
+                &d->top, &t, t + 1, memory_order_seq_cst,
+                memory_order_relaxed)) {
+            task = NULL;
+        }
+        atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+/**
+ * Podkrada zadanie z góry cudzej kolejki.
+ * @param[in,out] d : kolejka innego wątku
+ * @return zadanie albo NULL, jeśli kolejka jest pusta lub inny wątek był
+ * szybszy
+ */
+static PoolTask *PoolDequeSteal(PoolDeque *d) {
+    long t = atomic_load_explicit(&d->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+
+    if (t >= b) {
+        return NULL;
+    }
+
+    PoolTask *task = atomic_load_explicit(&d->tasks[t & (POOL_DEQUE_SIZE - 1)],
+                                          memory_order_relaxed);
+    if (!atomic_compare_exchange_strong_explicit(
+            &d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+/**
+ * Próbuje podkraść zadanie z kolejki dowolnego innego wątku. Przegląd
+ * kolejek zaczyna od losowej, żeby wątki nie rywalizowały o tę samą.
+ * @return zadanie albo NULL
+ */
+static PoolTask *PoolStealAny(void) {
+    poolRandom ^= poolRandom << 13;
+    poolRandom ^= poolRandom >> 17;
+    poolRandom ^= poolRandom << 5;
+
+    size_t start = poolRandom % poolDequeCount;
+    for (size_t i = 0; i < poolDequeCount; ++i) {
+        PoolDeque *d = &poolDeques[(start + i) % poolDequeCount];
+        if (d != poolSelf) {
+            PoolTask *task = PoolDequeSteal(d);
+            if (task != NULL) {
+                return task;
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Sprawdza, czy w którejś kolejce są zadania.
+ * @return Czy w którejś kolejce są zadania?
+ */
+static bool PoolHasWork(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+    for (size_t i = 0; i < poolDequeCount; ++i) {
+        if (atomic_load(&poolDeques[i].top) <
+            atomic_load(&poolDeques[i].bottom)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void PoolTaskRun(PoolTask *task);
+
+/**
+ * Wykonuje funkcję dla indeksów z przedziału @f$[begin, end)@f$, wystawiając
+ * prawe połowy przedziału innym wątkom.
+ * @param[in] function : funkcja
+ * @param[in] arg : argument funkcji
+ * @param[in] begin : pierwszy indeks
+ * @param[in] end : indeks za ostatnim
+ */
+static void PoolForRange(PoolFunction function, void *arg, size_t begin,
+                         size_t end) {
+    if (end - begin == 1) {
+        function(arg, begin);
+        return;
+    }
+
+    size_t mid = begin + (end - begin) / 2;
+    PoolTask task = {.function = function, .arg = arg, .begin = mid,
+                     .end = end};
+    atomic_init(&task.done, false);
+
+    if (!PoolDequePush(poolSelf, &task)) {
+        PoolForRange(function, arg, begin, mid);
+        PoolForRange(function, arg, mid, end);
+        return;
+    }
+
+    // budzimy uśpiony wątek, żeby podkradł wystawione zadanie
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(&poolSleepers) > 0) {
+        pthread_mutex_lock(&poolMutex);
+        pthread_cond_signal(&poolCond);
+        pthread_mutex_unlock(&poolMutex);
+    }
+
+    PoolForRange(function, arg, begin, mid);
+
+    // wywołania zagnieżdżone zdjęły już swoje zadania, więc na dole kolejki
+    // jest nasze zadanie, chyba że zostało podkradzione
+    if (PoolDequePop(poolSelf) == &task) {
+        PoolForRange(function, arg, mid, end);
+        return;
+    }
+
+    while (!atomic_load_explicit(&task.done, memory_order_acquire)) {
+        PoolTask *other = PoolStealAny();
+        if (other != NULL) {
+            PoolTaskRun(other);
+        }
+        else {
+            sched_yield();
+        }
+    }
+}
+
+/**
+ * Wykonuje zadanie i oznacza je jako wykonane.
+ * @param[in,out] task : zadanie
+ */
+static void PoolTaskRun(PoolTask *task) {
+    PoolForRange(task->function, task->arg, task->begin, task->end);
+    atomic_store_explicit(&task->done, true, memory_order_release);
+}
+
+/**
+ * Pętla wątku puli: podkrada i wykonuje zadania, a gdy ich brak, zasypia.
+ * @param[in] arg : kolejka wątku
+ * @return NULL
+ */
+static void *PoolWorker(void *arg) {
+    poolSelf = arg;
+    poolRandom = (unsigned)(poolSelf - poolDeques) + 1;
+    unsigned idle = 0;
+
+    while (!atomic_load(&poolShutdown)) {
+        PoolTask *task = PoolStealAny();
+        if (task != NULL) {
+            PoolTaskRun(task);
+            idle = 0;
+        }
+        else if (++idle < POOL_SPIN) {
+            sched_yield();
+        }
+        else {
+            pthread_mutex_lock(&poolMutex);
+            atomic_fetch_add(&poolSleepers, 1);
+            if (!atomic_load(&poolShutdown) && !PoolHasWork()) {
+                pthread_cond_wait(&poolCond, &poolMutex);
+            }
+            atomic_fetch_sub(&poolSleepers, 1);
+            pthread_mutex_unlock(&poolMutex);
+            idle = 0;
+        }
+    }
+
+    return NULL;
+}
+
+void PoolSetThreads(size_t count) {
+    pthread_mutex_lock(&poolMutex);
+    atomic_store(&poolShutdown, true);
+    pthread_cond_broadcast(&poolCond);
+    pthread_mutex_unlock(&poolMutex);
+
+    for (size_t i = 0; i < poolWorkerCount; ++i) {
+        pthread_join(poolWorkers[i], NULL);
+    }
+    free(poolWorkers);
+    free(poolDeques);
+    poolWorkers = NULL;
+    poolDeques = NULL;
+    poolWorkerCount = poolDequeCount = 0;
+    atomic_store(&poolShutdown, false);
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t maxCount = (cpus > 1 ? (size_t)cpus : 1) * POOL_THREADS_PER_CPU;
+    if (count > maxCount) {
+        count = maxCount;
+    }
+    if (count <= 1) {
+        return;
+    }
+
+    poolDequeCount = count - 1 + POOL_EXTERNAL_DEQUES;
+    poolDeques = calloc(poolDequeCount, sizeof (PoolDeque));
+    poolWorkers = malloc((count - 1) * sizeof (pthread_t));
+    CHECK_PTR(poolDeques);
+    CHECK_PTR(poolWorkers);
+
+    for (; poolWorkerCount < count - 1; ++poolWorkerCount) {
+        if (pthread_create(&poolWorkers[poolWorkerCount], NULL, PoolWorker,
+                           &poolDeques[poolWorkerCount]) != 0) {
+            // pula działa na wątkach, które udało się utworzyć, a kolejki
+            // pozostałych stają się kolejkami zewnętrznymi
+            break;
+        }
+    }
+}
+
+size_t PoolThreads(void) {
+    return poolWorkerCount + 1;
+}
+
+void PoolFor(size_t count, PoolFunction function, void *arg) {
+    if (count == 0) {
+        return;
+    }
+
+    bool external = false;
+    if (poolWorkerCount > 0 && count > 1 && poolSelf == NULL) {
+        // wątek spoza puli zajmuje wolną kolejkę zewnętrzną
+        for (size_t i = poolWorkerCount; i < poolDequeCount; ++i) {
+            bool expected = false;
+            if (atomic_compare_exchange_strong(&poolDeques[i].used, &expected,
+                                               true)) {
+                poolSelf = &poolDeques[i];
+                external = true;
+                break;
+            }
+        }
+    }
+
+    if (poolSelf == NULL) {
+        for (size_t i = 0; i < count; ++i) {
+            function(arg, i);
+        }
+        return;
+    }
+
+    PoolForRange(function, arg, 0, count);
+
+    if (external) {
+        atomic_store(&poolSelf->used, false);
+        poolSelf = NULL;
+    }
+}
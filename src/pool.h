@@ -0,0 +1,58 @@
+/** @file
+  Plik udostępnia pulę wątków, na której biblioteka wielomianów wykonuje
+  obliczenia równoległe.
+
+  Pula działa na zasadzie podkradania zadań: każdy wątek ma własną kolejkę
+  zadań, a wątki bez pracy podkradają zadania z cudzych kolejek. Wątek, który
+  zleca pracę puli, sam również ją wykonuje, a czekając na zakończenie
+  zleconych zadań, wykonuje zadania podkradzione innym wątkom. Dzięki temu
+  zagnieżdżone obliczenia równoległe korzystają z tej samej puli, nie
+  tworzą nowych wątków i nie mogą się zakleszczyć.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#ifndef POLYNOMIALS_POOL_H
+#define POLYNOMIALS_POOL_H
+
+#include <stddef.h>
+
+/**
+ * To jest typ funkcji wykonywanej równolegle przez PoolFor().
+ * @param[in] arg : argument przekazany do PoolFor()
+ * @param[in] i : indeks zadania
+ */
+typedef void (*PoolFunction)(void *arg, size_t i);
+
+/**
+ * Ustawia liczbę wątków wykonujących obliczenia, wliczając wątek, który
+ * zleca pracę. Dla wartości 0 albo 1 obliczenia są wykonywane sekwencyjnie
+ * w wątku, który je zleca. Liczba wątków jest ograniczana do czterech na
+ * dostępny procesor, a gdy systemowi zabraknie wątków, pula działa na tych,
+ * które udało się utworzyć; PoolThreads() daje rzeczywistą liczbę. Nie
+ * może być wywoływana w trakcie obliczeń równoległych.
+ * @param[in] count : liczba wątków
+ */
+void PoolSetThreads(size_t count);
+
+/**
+ * Daje liczbę wątków wykonujących obliczenia.
+ * @return liczba wątków
+ */
+size_t PoolThreads(void);
+
+/**
+ * Wykonuje równolegle @p function(@p arg, i) dla każdego
+ * @f$i = 0, 1, \ldots, count - 1@f$ i czeka, aż wszystkie wywołania się
+ * zakończą. Przedział indeksów jest dzielony rekurencyjnie na połowy, które
+ * mogą zostać podkradzione przez inne wątki, więc jedno wywołanie
+ * @p function powinno być na tyle duże, żeby opłacało się je wykonać
+ * osobno.
+ * @param[in] count : liczba zadań
+ * @param[in] function : funkcja wykonująca zadanie
+ * @param[in] arg : argument przekazywany do funkcji
+ */
+void PoolFor(size_t count, PoolFunction function, void *arg);
+
+#endif //POLYNOMIALS_POOL_H
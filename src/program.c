@@ -0,0 +1,469 @@
+/** @file
+  Implementacja skompilowanego programu kalkulatora.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#include "program.h"
+
+#include <assert.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * Sprawdza, czy udało się zaalokować pamięć. Jeśli nie, kończy działanie
+ * programu z kodem 1.
+ * @param[in] p : wskaźnik zwrócony przez funkcję alokującą pamięć
+ */
+#define CHECK_PTR(p)        \
+    do {                    \
+        if (p == NULL) {    \
+            exit(1);        \
+        }                   \
+    } while (0)
+
+/// nagłówek pliku z programem, zmieniany razem z formatem instrukcji
+#define PROGRAM_MAGIC "POLYBC1\n"
+
+/// długość nagłówka pliku z programem
+#define PROGRAM_MAGIC_LENGTH (sizeof (PROGRAM_MAGIC) - 1)
+
+/// początkowy rozmiar bufora na wczytywany program
+#define PROGRAM_READ_SIZE (1u << 16)
+
+/**
+ * Kody instrukcji. Kody poleceń są równe wartościom typu \ref Command,
+ * a kolejne kody oznaczają instrukcje, które nie są poleceniami.
+ */
+enum {
+    OP_PUSH = COMPOSE + 1, ///< wstawienie kolejnej stałej na stos
+    OP_ERROR, ///< wypisanie komunikatu błędu niepoprawnego wiersza
+    OP_END ///< koniec programu
+};
+
+/**
+ * To jest struktura czytnika zakodowanych danych programu.
+ */
+typedef struct {
+    const unsigned char *pos; ///< następny bajt
+    const unsigned char *end; ///< koniec danych
+} Decoder;
+
+/**
+ * Sprawdza, czy polecenie ma argument zapisany w instrukcji.
+ * @param[in] c : polecenie
+ * @return Czy polecenie ma argument?
+ */
+static inline bool HasArg(Command c) {
+    return c == DEG_BY || c == AT || c == COMPOSE;
+}
+
+/**
+ * Zapisuje liczbę w kodowaniu o zmiennej długości: po 7 bitów na bajt, od
+ * najmłodszych, z najstarszym bitem bajtu ustawionym, gdy po nim są kolejne.
+ * @param[in,out] writer : pisarz
+ * @param[in] value : liczba
+ */
+static void PutVarint(Writer *writer, uint64_t value) {
+    while (value >= 0x80) {
+        WriteChar(writer, (char)(value | 0x80));
+        value >>= 7;
+    }
+    WriteChar(writer, (char)value);
+}
+
+/**
+ * Zapisuje liczbę ze znakiem tak, żeby liczby o małym module, także
+ * ujemne, zajmowały mało bajtów: @f$0, -1, 1, -2, \ldots@f$ stają się
+ * liczbami @f$0, 1, 2, 3, \ldots@f$.
+ * @param[in,out] writer : pisarz
+ * @param[in] value : liczba
+ */
+static void PutSigned(Writer *writer, int64_t value) {
+    PutVarint(writer, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+/**
+ * Wczytuje liczbę zapisaną przez PutVarint().
+ * @param[in,out] d : czytnik
+ * @param[out] value : liczba
+ * @return Czy liczba jest poprawnie zapisana?
+ */
+static bool GetVarint(Decoder *d, uint64_t *value) {
+    *value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        if (d->pos == d->end) {
+            return false;
+        }
+        unsigned char byte = *d->pos++;
+        *value |= (uint64_t)(byte & 0x7f) << shift;
+        if (byte < 0x80) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Wczytuje liczbę zapisaną przez PutSigned().
+ * @param[in,out] d : czytnik
+ * @param[out] value : liczba
+ * @return Czy liczba jest poprawnie zapisana?
+ */
+static bool GetSigned(Decoder *d, int64_t *value) {
+    uint64_t u;
+    if (!GetVarint(d, &u)) {
+        return false;
+    }
+    *value = (int64_t)((u >> 1) ^ (0 - (u & 1)));
+    return true;
+}
+
+/// początkowa liczba ramek stosu przy zapisie i odczycie wielomianu
+#define PROGRAM_INITIAL_FRAMES 16
+
+/**
+ * To jest struktura ramki stosu przy zapisie wielomianu, czyli sumy
+ * jednomianów, której jednomiany są właśnie zapisywane.
+ */
+typedef struct {
+    const Poly *p; ///< zapisywana suma jednomianów
+    size_t i; ///< indeks następnego jednomianu
+} PutFrame;
+
+/**
+ * To jest struktura ramki stosu przy odczycie wielomianu, czyli sumy
+ * jednomianów, której jednomiany są właśnie odczytywane.
+ */
+typedef struct {
+    Mono *monos; ///< odczytane jednomiany, w tablicy z PolyMonosNew()
+    size_t size; ///< liczba jednomianów sumy
+    size_t i; ///< liczba odczytanych jednomianów
+    uint64_t exp; ///< wykładnik ostatniego jednomianu
+} GetFrame;
+
+/**
+ * Zapewnia miejsce na kolejną ramkę stosu.
+ * @param[in,out] frames : stos ramek
+ * @param[in] depth : liczba ramek na stosie
+ * @param[in,out] allocated : rozmiar stosu
+ * @param[in] frameSize : rozmiar ramki
+ * @return stos ramek
+ */
+static void *GrowFrames(void *frames, size_t depth, size_t *allocated,
+                        size_t frameSize) {
+    if (depth == *allocated) {
+        *allocated = *allocated == 0 ? PROGRAM_INITIAL_FRAMES : 2 * *allocated;
+        frames = realloc(frames, *allocated * frameSize);
+        CHECK_PTR(frames);
+    }
+    return frames;
+}
+
+/**
+ * Zapisuje wielomian binarnie: współczynnik jako 0 i jego wartość, a sumę
+ * jednomianów jako liczbę jednomianów i dla każdego jednomianu przyrost
+ * wykładnika oraz wielomian. Zagnieżdżenie wielomianu nie zajmuje stosu
+ * wywołań.
+ * @param[in,out] writer : pisarz
+ * @param[in] p : wielomian
+ */
+static void PutPoly(Writer *writer, const Poly *p) {
+    PutFrame *frames = NULL;
+    size_t depth = 0, allocated = 0;
+
+    while (p != NULL) {
+        if (PolyIsCoeff(p)) {
+            PutVarint(writer, 0);
+            PutSigned(writer, p->coeff);
+        }
+        else {
+            PutVarint(writer, p->size);
+            frames = GrowFrames(frames, depth, &allocated, sizeof (PutFrame));
+            frames[depth++] = (PutFrame) {.p = p};
+        }
+
+        // następny jednomian najgłębszej niezapisanej do końca sumy
+        p = NULL;
+        while (depth > 0 && p == NULL) {
+            PutFrame *f = &frames[depth - 1];
+            if (f->i == f->p->size) {
+                depth--;
+                continue;
+            }
+            poly_exp_t prev = f->i > 0 ? MonoGetExp(&f->p->arr[f->i - 1]) : 0;
+            PutVarint(writer, (uint64_t)(MonoGetExp(&f->p->arr[f->i]) - prev));
+            p = &f->p->arr[f->i++].p;
+        }
+    }
+
+    free(frames);
+}
+
+/**
+ * Wczytuje wielomian zapisany przez PutPoly(). Wielomian musi być
+ * w postaci kanonicznej, tak jak każdy wielomian zapisany przez kompilator.
+ * Zagnieżdżenie wielomianu nie zajmuje stosu wywołań.
+ * @param[in,out] d : czytnik
+ * @param[out] p : wielomian
+ * @return Czy wielomian jest poprawnie zapisany?
+ */
+static bool GetPoly(Decoder *d, Poly *p) {
+    GetFrame *frames = NULL;
+    size_t depth = 0, allocated = 0;
+    bool done = false;
+
+    while (!done) {
+        uint64_t size;
+        if (!GetVarint(d, &size)) {
+            break;
+        }
+
+        if (size > 0) {
+            // każdy jednomian zajmuje co najmniej 3 bajty
+            if (size > (uint64_t)(d->end - d->pos) / 3) {
+                break;
+            }
+            frames = GrowFrames(frames, depth, &allocated, sizeof (GetFrame));
+            frames[depth++] = (GetFrame) {.monos = PolyMonosNew(size),
+                                          .size = size};
+        }
+        else {
+            int64_t coeff;
+            if (!GetSigned(d, &coeff) || (coeff == 0 && depth > 0)) {
+                break;
+            }
+
+            // wczytany wielomian dopełnia jednomian otwartej sumy, która
+            // może się przez to zakończyć
+            Poly q = PolyFromCoeff(coeff);
+            while (depth > 0) {
+                GetFrame *f = &frames[depth - 1];
+                f->monos[f->i++] = MonoFromPoly(&q, (poly_exp_t)f->exp);
+                if (f->i < f->size) {
+                    break;
+                }
+                q = PolyOwnSortedMonos(f->size, f->monos);
+                depth--;
+            }
+            if (depth == 0) {
+                *p = q;
+                done = true;
+                break;
+            }
+        }
+
+        // wykładnik następnego jednomianu najgłębszej otwartej sumy
+        GetFrame *f = &frames[depth - 1];
+        uint64_t delta;
+        if (!GetVarint(d, &delta) || (f->i > 0 && delta == 0) ||
+            delta > INT_MAX || f->exp + delta > INT_MAX) {
+            break;
+        }
+        f->exp += delta;
+    }
+
+    for (size_t k = 0; k < depth; ++k) {
+        for (size_t j = 0; j < frames[k].i; ++j) {
+            MonoDestroy(&frames[k].monos[j]);
+        }
+        PolyMonosFree(frames[k].monos);
+    }
+    free(frames);
+    return done;
+}
+
+/**
+ * Wczytuje instrukcję.
+ * @param[in,out] d : czytnik
+ * @param[out] op : kod instrukcji
+ * @param[out] delta : przyrost numeru wiersza
+ * @param[out] arg : argument polecenia
+ * @param[out] msg : komunikat błędu
+ * @return Czy instrukcja jest poprawnie zapisana?
+ */
+static bool GetInstruction(Decoder *d, unsigned *op, uint64_t *delta,
+                           int64_t *arg, const char **msg) {
+    if (d->pos == d->end) {
+        return false;
+    }
+    *op = *d->pos++;
+    if (*op == OP_END) {
+        return true;
+    }
+    if (*op > OP_ERROR || !GetVarint(d, delta)) {
+        return false;
+    }
+
+    if (*op == OP_ERROR) {
+        const unsigned char *nul = memchr(d->pos, '\0', d->end - d->pos);
+        if (nul == NULL) {
+            return false;
+        }
+        *msg = (const char *)d->pos;
+        d->pos = nul + 1;
+        return true;
+    }
+
+    return *op == OP_PUSH || !HasArg((Command)*op) || GetSigned(d, arg);
+}
+
+Program ProgramNew(void) {
+    return (Program) {
+        .consts = WriterGrowing(),
+        .code = WriterGrowing()
+    };
+}
+
+void ProgramFree(Program *self) {
+    WriterFree(&self->consts);
+    WriterFree(&self->code);
+    if (self->pool != NULL) {
+        for (size_t i = self->next; i < self->constCount; ++i) {
+            PolyDestroy(&self->pool[i]);
+        }
+        free(self->pool);
+    }
+    free(self->data);
+}
+
+void ProgramAddLine(Program *self, const Line *line, size_t lineNr) {
+    assert(lineNr >= self->lineNr);
+
+    if (line->status == POLY) {
+        WriteChar(&self->code, OP_PUSH);
+        PutPoly(&self->consts, &line->p);
+        self->constCount++;
+        Poly p = line->p;
+        PolyDestroy(&p);
+    }
+    else if (line->status == ERROR) {
+        WriteChar(&self->code, OP_ERROR);
+        self->errorCount++;
+    }
+    else {
+        WriteChar(&self->code, (char)line->c);
+    }
+    PutVarint(&self->code, lineNr - self->lineNr);
+    self->lineNr = lineNr;
+
+    if (line->status == ERROR) {
+        for (const char *c = line->msg; *c != '\0'; ++c) {
+            WriteChar(&self->code, *c);
+        }
+        WriteChar(&self->code, '\0');
+    }
+    else if (line->status == COMMAND && HasArg(line->c)) {
+        PutSigned(&self->code, line->arg);
+    }
+}
+
+void ProgramWrite(Program *self, Writer *writer) {
+    for (const char *c = PROGRAM_MAGIC; *c != '\0'; ++c) {
+        WriteChar(writer, *c);
+    }
+    PutVarint(writer, self->constCount);
+    WriteChar(&self->code, (char)OP_END);
+    WriterWriteParts(writer, &self->consts, 1);
+    WriterWriteParts(writer, &self->code, 1);
+}
+
+/**
+ * Wczytuje całą zawartość pliku do bufora programu.
+ * @param[in,out] self : program
+ * @param[in,out] file : plik
+ * @return długość zawartości pliku
+ */
+static size_t ProgramReadFile(Program *self, FILE *file) {
+    size_t size = 0, allocated = PROGRAM_READ_SIZE;
+    self->data = malloc(allocated);
+    CHECK_PTR(self->data);
+
+    size_t n;
+    while ((n = fread(self->data + size, 1, allocated - size, file)) > 0) {
+        size += n;
+        if (size == allocated) {
+            allocated *= 2;
+            self->data = realloc(self->data, allocated);
+            CHECK_PTR(self->data);
+        }
+    }
+    return size;
+}
+
+bool ProgramLoad(Program *self, FILE *file) {
+    *self = (Program) {0};
+    self->size = ProgramReadFile(self, file);
+    Decoder d = {.pos = self->data, .end = self->data + self->size};
+
+    uint64_t count;
+    if (self->size < PROGRAM_MAGIC_LENGTH ||
+        memcmp(d.pos, PROGRAM_MAGIC, PROGRAM_MAGIC_LENGTH) != 0) {
+        return false;
+    }
+    d.pos += PROGRAM_MAGIC_LENGTH;
+    // każda stała zajmuje co najmniej 2 bajty
+    if (!GetVarint(&d, &count) || count > (uint64_t)(d.end - d.pos) / 2) {
+        return false;
+    }
+
+    if (count > 0) {
+        self->pool = malloc(count * sizeof (Poly));
+        CHECK_PTR(self->pool);
+    }
+    for (; self->constCount < count; ++self->constCount) {
+        if (!GetPoly(&d, &self->pool[self->constCount])) {
+            return false;
+        }
+    }
+    self->pc = d.pos - self->data;
+
+    // cały ciąg instrukcji jest sprawdzany przed wykonaniem programu
+    size_t pushes = 0;
+    unsigned op = OP_END;
+    do {
+        uint64_t delta;
+        int64_t arg;
+        const char *msg;
+        if (!GetInstruction(&d, &op, &delta, &arg, &msg)) {
+            return false;
+        }
+        pushes += op == OP_PUSH;
+    } while (op != OP_END);
+
+    return pushes == count && d.pos == d.end;
+}
+
+bool ProgramNext(Program *self, Line *line, size_t *lineNr) {
+    Decoder d = {.pos = self->data + self->pc, .end = self->data + self->size};
+    unsigned op = OP_END;
+    uint64_t delta = 0;
+    int64_t arg = 0;
+    const char *msg = NULL;
+
+    // ciąg instrukcji został sprawdzony przez ProgramLoad()
+    GetInstruction(&d, &op, &delta, &arg, &msg);
+    if (op == OP_END) {
+        return false;
+    }
+    self->pc = d.pos - self->data;
+    self->lineNr += delta;
+    *lineNr = self->lineNr;
+
+    if (op == OP_PUSH) {
+        *line = PolyLine(self->pool[self->next++]);
+    }
+    else if (op == OP_ERROR) {
+        *line = WrongLine(msg);
+    }
+    else if (HasArg((Command)op)) {
+        *line = CommandLineWithArg((Command)op, arg);
+    }
+    else {
+        *line = CommandLine((Command)op);
+    }
+    return true;
+}
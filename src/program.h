@@ -0,0 +1,98 @@
+/** @file
+  Plik udostępnia skompilowany program kalkulatora, czyli skrypt zamieniony
+  na zwarty ciąg instrukcji w postaci binarnej.
+
+  Program zawiera pulę stałych, czyli wielomianów ze skryptu zapisanych
+  binarnie, oraz ciąg instrukcji. Instrukcja to kod polecenia, przyrost
+  numeru wiersza skryptu, z którego pochodzi, i ewentualny argument.
+  Wiersz z wielomianem staje się instrukcją wstawienia kolejnej stałej na
+  stos, a niepoprawny wiersz instrukcją wypisania jego komunikatu błędu.
+  Liczby są zapisywane w kodowaniu o zmiennej długości, po 7 bitów na bajt.
+  Wykonanie programu nie wymaga więc ani rozpoznawania poleceń, ani
+  konwersji wielomianów z tekstu, a błędy są zgłaszane z numerami wierszy
+  skryptu.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#ifndef POLYNOMIALS_PROGRAM_H
+#define POLYNOMIALS_PROGRAM_H
+
+#include "line.h"
+#include "poly.h"
+#include "write.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/**
+ * To jest struktura programu kalkulatora. Program jest albo kompilowany
+ * przez ProgramAddLine() i zapisywany przez ProgramWrite(), albo wczytywany
+ * przez ProgramLoad() i wykonywany instrukcja po instrukcji przez
+ * ProgramNext().
+ */
+typedef struct {
+    Writer consts; ///< zakodowane stałe kompilowanego programu
+    Writer code; ///< zakodowane instrukcje kompilowanego programu
+    size_t constCount; ///< liczba stałych
+    size_t lineNr; ///< numer wiersza ostatniej instrukcji
+    size_t errorCount; ///< liczba niepoprawnych wierszy kompilowanego skryptu
+    Poly *pool; ///< stałe wczytanego programu, jeszcze niewstawione na stos
+    size_t next; ///< indeks następnej stałej
+    unsigned char *data; ///< zawartość pliku wczytanego programu
+    size_t size; ///< długość zawartości pliku
+    size_t pc; ///< pozycja następnej instrukcji w @p data
+} Program;
+
+/**
+ * Tworzy pusty program do kompilacji.
+ * @return program
+ */
+Program ProgramNew(void);
+
+/**
+ * Zwalnia pamięć używaną przez program, także niewykorzystane stałe.
+ * @param[in,out] self : program
+ */
+void ProgramFree(Program *self);
+
+/**
+ * Dodaje do kompilowanego programu instrukcję odpowiadającą wierszowi
+ * skryptu. Przejmuje na własność wielomian z wiersza.
+ * @param[in,out] self : program
+ * @param[in] line : wiersz
+ * @param[in] lineNr : numer wiersza, nie mniejszy niż w poprzednim wywołaniu
+ */
+void ProgramAddLine(Program *self, const Line *line, size_t lineNr);
+
+/**
+ * Zapisuje skompilowany program w postaci binarnej.
+ * @param[in,out] self : program
+ * @param[in,out] writer : pisarz
+ */
+void ProgramWrite(Program *self, Writer *writer);
+
+/**
+ * Wczytuje program zapisany przez ProgramWrite() i sprawdza jego
+ * poprawność, zanim wykona się którakolwiek instrukcja. Program trzeba
+ * zwolnić przez ProgramFree() także wtedy, gdy nie jest poprawny.
+ * @param[out] self : program
+ * @param[in,out] file : plik z programem
+ * @return Czy program jest poprawny?
+ */
+bool ProgramLoad(Program *self, FILE *file);
+
+/**
+ * Daje kolejną instrukcję wczytanego programu jako wiersz, tak jakby
+ * został on skonwertowany z tekstu skryptu. Wielomian z wiersza przechodzi
+ * na własność wywołującego.
+ * @param[in,out] self : program
+ * @param[out] line : wiersz
+ * @param[out] lineNr : numer wiersza w skrypcie
+ * @return `false` gdy program się skończył, w przeciwnym razie `true`
+ */
+bool ProgramNext(Program *self, Line *line, size_t *lineNr);
+
+#endif //POLYNOMIALS_PROGRAM_H
@@ -5,45 +5,194 @@
   @date 2021
 */
 
+#define _DEFAULT_SOURCE
+
 #include "read.h"
-#include "vector.h"
 
 #include <assert.h>
+#include <errno.h>
 #include <stdbool.h>
-#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /**
- * Wczytuje znaki aż do napotkania '\n' lub EOF i porzuca je.
+ * Sprawdza, czy udało się zaalokować pamięć. Jeśli nie, kończy działanie
+ * programu z kodem 1.
+ * @param[in] p : wskaźnik zwrócony przez funkcję alokującą pamięć
  */
-static inline void SkipLine() {
-    char c;
-    while ((c = (char)getchar()) != EOF && c != '\n');
-}
-
-bool ReadLine(CVector *input) {
-    assert(input && CVectorEmpty(input));
+#define CHECK_PTR(p)        \
+    do {                    \
+        if (p == NULL) {    \
+            exit(1);        \
+        }                   \
+    } while (0)
 
-    char c = (char)getchar();
+/// rozmiar bufora czytelnika; dłuższe wiersze zwracane są we fragmentach
+#define READ_BUFFER_SIZE (1u << 20)
 
-    if (feof(stdin)) {
-        return true;
+/**
+ * Próbuje odwzorować w pamięci plik @p fd od bieżącej pozycji do końca.
+ * Udaje się to tylko dla niepustego zwykłego pliku. Po odwzorowaniu cały plik
+ * jest już w buforze czytelnika, więc czytelnik od razu ma ustawiony koniec
+ * wejścia.
+ * @param[in] fd : deskryptor czytanego pliku
+ * @param[out] reader : czytelnik czytający odwzorowany plik
+ * @return Czy udało się odwzorować plik?
+ */
+static bool ReaderMap(int fd, Reader *reader) {
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        return false;
     }
 
-    if (c == '#') {
-        SkipLine();
+    // plik mógł być już częściowo przeczytany, np. przez powłokę
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+    if (offset < 0 || offset >= st.st_size ||
+        (uintmax_t)st.st_size > SIZE_MAX) {
         return false;
     }
 
-    if (c == '\n') {
+    size_t size = st.st_size;
+    void *map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
         return false;
     }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    *reader = (Reader) {
+        .fd = fd,
+        .buf = map,
+        .mapped = true,
+        .begin = offset,
+        .scan = offset,
+        .end = size,
+        .allocated = size,
+        .eof = true
+    };
+    return true;
+}
+
+Reader ReaderNew(int fd) {
+    Reader reader;
+    if (ReaderMap(fd, &reader)) {
+        return reader;
+    }
+
+    char *buf = malloc(READ_BUFFER_SIZE);
+    CHECK_PTR(buf);
+
+    return (Reader) {
+        .fd = fd,
+        .buf = buf,
+        .allocated = READ_BUFFER_SIZE
+    };
+}
+
+void ReaderFree(Reader *self) {
+    if (self->mapped) {
+        munmap(self->buf, self->allocated);
+    }
+    else {
+        free(self->buf);
+    }
+    self->buf = NULL;
+}
+
+/**
+ * Doczytuje kolejny blok wejścia do bufora. Niezwrócony jeszcze fragment
+ * wiersza jest przesuwany na początek bufora, który nie może być nim
+ * wypełniony. Błąd odczytu jest traktowany tak jak koniec wejścia.
+ * @param[in,out] self : czytelnik
+ */
+static void ReaderFill(Reader *self) {
+    if (self->begin > 0) {
+        memmove(self->buf, self->buf + self->begin, self->end - self->begin);
+        self->scan -= self->begin;
+        self->end -= self->begin;
+        self->begin = 0;
+    }
+    assert(self->end < self->allocated);
 
+    ssize_t n;
     do {
-        CVectorPush(input, c);
-        c = (char)getchar();
-    } while (!feof(stdin) && c != '\n');
+        n = read(self->fd, self->buf + self->end, self->allocated - self->end);
+    } while (n < 0 && errno == EINTR);
+
+    if (n <= 0) {
+        self->eof = true;
+    }
+    else {
+        self->end += n;
+    }
+}
+
+/**
+ * Sprawdza, czy wiersz, którego fragment zaczyna się w @p begin, jest
+ * komentarzem.
+ * @param[in] self : czytelnik
+ * @param[in] begin : początek fragmentu
+ * @param[in] end : koniec fragmentu
+ * @return Czy wiersz jest komentarzem?
+ */
+static inline bool ReaderIsComment(const Reader *self, const char *begin,
+                                   const char *end) {
+    return self->comment || (!self->midLine && begin < end && *begin == '#');
+}
 
-    CVectorPush(input, '\0');
+bool ReadLine(Reader *self, const char **line, size_t *length,
+              bool *lineEnd) {
+    assert(self && line && length && lineEnd);
+
+    char *newline;
+    while ((newline = memchr(self->buf + self->scan, '\n',
+                             self->end - self->scan)) == NULL) {
+        self->scan = self->end;
+        if (self->eof) {
+            break;
+        }
+
+        if (self->end - self->begin == self->allocated) {
+            // wiersz nie mieści się w buforze, więc oddajemy jego fragment,
+            // a fragmenty komentarza pomijamy
+            const char *begin = self->buf + self->begin;
+            self->comment = ReaderIsComment(self, begin, self->buf + self->end);
+            self->midLine = true;
+            self->begin = self->end;
+            if (!self->comment) {
+                *line = begin;
+                *length = self->allocated;
+                *lineEnd = false;
+                return false;
+            }
+        }
+        ReaderFill(self);
+    }
+
+    const char *begin = self->buf + self->begin;
+
+    if (newline == NULL) { // ostatni wiersz, niezakończony znakiem '\n'
+        if (self->begin == self->end && !self->midLine) {
+            return true;
+        }
+        newline = self->buf + self->end;
+    }
+
+    *line = begin;
+    *length = ReaderIsComment(self, begin, newline) ?
+              0 : (size_t)(newline - begin);
+    *lineEnd = true;
+
+    self->begin = newline - self->buf + 1;
+    if (self->begin > self->end) { // zwrócono ostatni wiersz
+        self->begin = self->end;
+    }
+    self->scan = self->begin;
+    self->midLine = false;
+    self->comment = false;
 
     return false;
 }
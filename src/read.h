@@ -1,6 +1,15 @@
 /** @file
   Interfejs modułu odpowiedzialnego za wczytywanie wejścia.
 
+  Gdy wejście jest zwykłym plikiem, czytelnik odwzorowuje go w pamięci
+  funkcją mmap(2) i wiersze są czytane wprost z odwzorowanych stron.
+  W przeciwnym razie wejście jest wczytywane dużymi blokami funkcją read(2)
+  do bufora stałego rozmiaru, a wiersz dłuższy niż bufor zwracany jest we
+  fragmentach, więc nie trzeba trzymać go w pamięci w całości. Końce wierszy
+  wyszukuje memchr. Wiersze nie są kopiowane ani
+  zmieniane: czytelnik zwraca wskaźnik na wiersz i jego długość, a wiersz nie
+  kończy się znakiem '\0'.
+
   @authors Mateusz Malinowski
   @date 2021
 */
@@ -8,14 +17,57 @@
 #ifndef SIMILAR_LINES_READINPUT_H
 #define SIMILAR_LINES_READINPUT_H
 
-#include "vector.h"
 #include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * To jest struktura czytelnika wczytującego wejście wierszami.
+ */
+typedef struct {
+    int fd; ///< deskryptor czytanego pliku
+    char *buf; ///< bufor na wczytane znaki albo odwzorowany plik
+    bool mapped; ///< czy @p buf jest plikiem odwzorowanym w pamięci
+    size_t begin; ///< początek pierwszego niezwróconego wiersza w buforze
+    size_t scan; ///< miejsce, od którego trzeba szukać końca wiersza
+    size_t end; ///< koniec wczytanych znaków w buforze
+    size_t allocated; ///< rozmiar bufora
+    bool eof; ///< czy wczytano już całe wejście
+    bool midLine; ///< czy zwrócono już fragment bieżącego wiersza
+    bool comment; ///< czy bieżący wiersz, pomijany we fragmentach, jest
+                  ///< komentarzem
+} Reader;
+
+/**
+ * Tworzy czytelnika wczytującego wejście z deskryptora @p fd. Jeżeli @p fd
+ * jest zwykłym plikiem, czytelnik odwzorowuje w pamięci jego część od
+ * bieżącej pozycji do końca.
+ * @param[in] fd : deskryptor czytanego pliku
+ * @return czytelnik
+ */
+Reader ReaderNew(int fd);
+
+/**
+ * Zwalnia pamięć używaną przez czytelnika i usuwa odwzorowanie pliku. Nie
+ * zamyka deskryptora.
+ * @param[in,out] self : czytelnik
+ */
+void ReaderFree(Reader *self);
 
 /**
- * Wczytuje wiersz znak po znaku.
- * @param[out] input : pusty bufor na wczytywane znaki
+ * Wczytuje wiersz albo jego kolejny fragment. Wiersz, który nie mieści się
+ * w buforze czytelnika, zwracany jest w kilku fragmentach, a @p lineEnd jest
+ * ustawiane na true tylko dla ostatniego z nich. Ostatni fragment może być
+ * pusty. Fragment nie zawiera kończącego wiersz znaku '\n' i pozostaje ważny
+ * do następnego wywołania funkcji. Dla wiersza pustego i dla komentarza
+ * (wiersza zaczynającego się znakiem '#') funkcja zwraca jeden pusty
+ * fragment.
+ * @param[in,out] self : czytelnik
+ * @param[out] line : wskaźnik na początek fragmentu w buforze czytelnika
+ * @param[out] length : długość fragmentu
+ * @param[out] lineEnd : czy fragment kończy wiersz
  * @return `true` gdy natrafi na EOF, w przeciwnym razie `false`
  */
-bool ReadLine(CVector *input);
+bool ReadLine(Reader *self, const char **line, size_t *length,
+              bool *lineEnd);
 
 #endif //SIMILAR_LINES_READINPUT_H
@@ -56,7 +56,7 @@ void StackPop(Stack *self) {
 }
 
 void StackHardPop(Stack *self) {
-    PolyDestroy(&self->items[--self->size]);
+    PolyDestroyDeferred(&self->items[--self->size]);
 }
 
 Poly StackTop(const Stack *self) {
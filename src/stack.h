@@ -48,7 +48,8 @@ void StackPush(Stack *self, Poly p);
 void StackPop(Stack *self);
 
 /**
- * Usuwa wielomian z wierzchołka stosu i go niszczy.
+ * Usuwa wielomian z wierzchołka stosu i go niszczy. Duży wielomian jest
+ * niszczony w tle przez PolyDestroyDeferred().
  * @param[in,out] self : stos
  */
 void StackHardPop(Stack *self);
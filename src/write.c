@@ -0,0 +1,199 @@
+/** @file
+  Implementacja buforowanego pisarza.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#define _DEFAULT_SOURCE
+
+#include "write.h"
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/**
+ * Sprawdza, czy udało się zaalokować pamięć. Jeśli nie, kończy działanie
+ * programu z kodem 1.
+ * @param[in] p : wskaźnik zwrócony przez funkcję alokującą pamięć
+ */
+#define CHECK_PTR(p)        \
+    do {                    \
+        if (p == NULL) {    \
+            exit(1);        \
+        }                   \
+    } while (0)
+
+/// rozmiar bufora pisarza tworzonego przez WriterNew()
+#define WRITE_BUFFER_SIZE (1u << 20)
+
+/// początkowy rozmiar bufora pisarza bez strumienia
+#define WRITE_GROWING_SIZE (1u << 16)
+
+/// największa liczba fragmentów przekazywana do jednego wywołania writev(2)
+#ifdef IOV_MAX
+#define WRITE_MAX_IOV IOV_MAX
+#else
+#define WRITE_MAX_IOV 1024
+#endif
+
+/// zapisy dziesiętne liczb od 0 do 99, każdy na dwóch znakach
+static const char digitPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+Writer WriterNew(FILE *file) {
+    char *buf = malloc(WRITE_BUFFER_SIZE);
+    CHECK_PTR(buf);
+
+    return (Writer) {
+        .file = file,
+        .buf = buf,
+        .allocated = WRITE_BUFFER_SIZE,
+        .owned = true
+    };
+}
+
+Writer WriterOnBuffer(FILE *file, char *buf, size_t allocated) {
+    assert(allocated >= WRITE_LONG_MAX_LENGTH);
+
+    return (Writer) {
+        .file = file,
+        .buf = buf,
+        .allocated = allocated
+    };
+}
+
+Writer WriterGrowing(void) {
+    char *buf = malloc(WRITE_GROWING_SIZE);
+    CHECK_PTR(buf);
+
+    return (Writer) {
+        .buf = buf,
+        .allocated = WRITE_GROWING_SIZE,
+        .owned = true
+    };
+}
+
+void WriterFlush(Writer *self) {
+    if (self->file == NULL) {
+        assert(self->owned);
+        self->allocated *= 2;
+        self->buf = realloc(self->buf, self->allocated);
+        CHECK_PTR(self->buf);
+    }
+    else if (self->size > 0) {
+        fwrite(self->buf, 1, self->size, self->file);
+        self->size = 0;
+    }
+}
+
+/**
+ * Wypisuje fragmenty wprost do pliku @p fd, ponawiając zapis po przerwaniu
+ * przez sygnał i po zapisaniu tylko części fragmentów. Błąd zapisu kończy
+ * wypisywanie, tak jak fwrite() pomija błędy w WriterFlush().
+ * @param[in] fd : deskryptor pliku
+ * @param[in,out] iov : fragmenty, zmieniane w trakcie zapisu
+ * @param[in] count : liczba fragmentów
+ */
+static void WriteAll(int fd, struct iovec *iov, size_t count) {
+    while (count > 0) {
+        ssize_t n = writev(fd, iov, count < WRITE_MAX_IOV ?
+                                    (int)count : WRITE_MAX_IOV);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+
+        // pomija zapisane w całości fragmenty i początek zapisanego częściowo
+        size_t written = n;
+        while (count > 0 && written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            count--;
+        }
+        if (count > 0) {
+            iov->iov_base = (char *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+}
+
+void WriterWriteParts(Writer *self, Writer parts[], size_t count) {
+    assert(self->file != NULL);
+    WriterFlush(self);
+
+    int fd = fileno(self->file);
+    if (fd < 0 || fflush(self->file) != 0) {
+        // strumień bez deskryptora, np. w pamięci
+        for (size_t i = 0; i < count; ++i) {
+            fwrite(parts[i].buf, 1, parts[i].size, self->file);
+            parts[i].size = 0;
+        }
+        return;
+    }
+
+    struct iovec *iov = malloc(count * sizeof (struct iovec));
+    CHECK_PTR(iov);
+
+    size_t used = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (parts[i].size > 0) {
+            iov[used++] = (struct iovec) {.iov_base = parts[i].buf,
+                                          .iov_len = parts[i].size};
+            parts[i].size = 0;
+        }
+    }
+    WriteAll(fd, iov, used);
+    free(iov);
+}
+
+void WriterFree(Writer *self) {
+    if (self->file != NULL) {
+        WriterFlush(self);
+    }
+    if (self->owned) {
+        free(self->buf);
+    }
+    self->buf = NULL;
+}
+
+void WriteLong(Writer *self, long value) {
+    WriterReserve(self, WRITE_LONG_MAX_LENGTH);
+
+    // moduł liczony na typie bez znaku, żeby LONG_MIN nie przepełnił typu
+    uint64_t v = value < 0 ? -(uint64_t)value : (uint64_t)value;
+    char digits[WRITE_LONG_MAX_LENGTH];
+    char *begin = digits + sizeof digits;
+
+    // cyfry od najmniej znaczących, po dwie naraz
+    while (v >= 100) {
+        begin -= 2;
+        memcpy(begin, digitPairs + 2 * (v % 100), 2);
+        v /= 100;
+    }
+    if (v >= 10) {
+        begin -= 2;
+        memcpy(begin, digitPairs + 2 * v, 2);
+    }
+    else {
+        *--begin = (char)('0' + v);
+    }
+    if (value < 0) {
+        *--begin = '-';
+    }
+
+    size_t length = digits + sizeof digits - begin;
+    memcpy(self->buf + self->size, begin, length);
+    self->size += length;
+}
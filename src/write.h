@@ -0,0 +1,119 @@
+/** @file
+  Plik udostępnia buforowany pisarz, przez który wypisywane są wielomiany
+  i odpowiedzi kalkulatora.
+
+  Pisarz zbiera wypisywane znaki w dużym buforze i przekazuje je do
+  strumienia jednym wywołaniem fwrite() dopiero wtedy, gdy bufor się zapełni
+  albo gdy wywołujący jawnie go opróżni. Liczby są zamieniane na zapis
+  dziesiętny bez printf(), po dwie cyfry naraz. Pisarz bez strumienia
+  zbiera cały tekst w powiększanym buforze, dzięki czemu fragmenty tekstu
+  mogą być przygotowywane równolegle i wypisane potem po kolei.
+
+  @authors Mateusz Malinowski
+  @date 2021
+*/
+
+#ifndef POLYNOMIALS_WRITE_H
+#define POLYNOMIALS_WRITE_H
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+/// najdłuższy zapis dziesiętny liczby typu long, ze znakiem '-'
+#define WRITE_LONG_MAX_LENGTH 20
+
+/**
+ * To jest struktura pisarza.
+ */
+typedef struct {
+    FILE *file; ///< strumień, do którego trafia zawartość bufora, albo NULL
+    char *buf; ///< bufor
+    size_t size; ///< liczba znaków w buforze
+    size_t allocated; ///< rozmiar bufora
+    bool owned; ///< czy bufor został zaalokowany przez pisarza
+} Writer;
+
+/**
+ * Tworzy pisarza piszącego do strumienia @p file z dużym buforem.
+ * @param[in] file : strumień
+ * @return pisarz
+ */
+Writer WriterNew(FILE *file);
+
+/**
+ * Tworzy pisarza piszącego do strumienia @p file, który używa bufora
+ * wywołującego, np. tablicy na stosie.
+ * @param[in] file : strumień
+ * @param[in] buf : bufor
+ * @param[in] allocated : rozmiar bufora, nie mniejszy niż
+ *                        @ref WRITE_LONG_MAX_LENGTH
+ * @return pisarz
+ */
+Writer WriterOnBuffer(FILE *file, char *buf, size_t allocated);
+
+/**
+ * Tworzy pisarza bez strumienia, który zamiast opróżniać bufor, powiększa
+ * go.
+ * @return pisarz
+ */
+Writer WriterGrowing(void);
+
+/**
+ * Przekazuje zawartość bufora do strumienia. Strumień może ją dalej
+ * buforować tak jak każdy inny zapis, np. do końca wiersza na terminalu.
+ * Pisarz bez strumienia zamiast tego powiększa bufor dwukrotnie.
+ * @param[in,out] self : pisarz
+ */
+void WriterFlush(Writer *self);
+
+/**
+ * Wypisuje po kolei teksty zebrane przez pisarzy bez strumienia @p parts,
+ * po tekście z bufora pisarza @p self, i opróżnia bufory @p parts. Jeśli
+ * strumień ma deskryptor pliku, teksty są wypisywane wprost do niego
+ * funkcją writev(2), bez kopiowania.
+ * @param[in,out] self : pisarz
+ * @param[in,out] parts : pisarze bez strumienia
+ * @param[in] count : liczba pisarzy @p parts
+ */
+void WriterWriteParts(Writer *self, Writer parts[], size_t count);
+
+/**
+ * Przekazuje zawartość bufora do strumienia i zwalnia pamięć używaną przez
+ * pisarza. Tekst zebrany przez pisarza bez strumienia przepada.
+ * @param[in,out] self : pisarz
+ */
+void WriterFree(Writer *self);
+
+/**
+ * Zapewnia, że w buforze jest miejsce na @p n znaków, w razie potrzeby
+ * opróżniając bufor.
+ * @param[in,out] self : pisarz
+ * @param[in] n : liczba znaków, nie większa niż rozmiar bufora
+ */
+static inline void WriterReserve(Writer *self, size_t n) {
+    assert(n <= self->allocated);
+    if (self->allocated - self->size < n) {
+        WriterFlush(self);
+    }
+}
+
+/**
+ * Wypisuje znak.
+ * @param[in,out] self : pisarz
+ * @param[in] c : znak
+ */
+static inline void WriteChar(Writer *self, char c) {
+    WriterReserve(self, 1);
+    self->buf[self->size++] = c;
+}
+
+/**
+ * Wypisuje liczbę w zapisie dziesiętnym.
+ * @param[in,out] self : pisarz
+ * @param[in] value : liczba
+ */
+void WriteLong(Writer *self, long value);
+
+#endif //POLYNOMIALS_WRITE_H